@@ -0,0 +1,768 @@
+#include <cassert>
+#include "board.h"
+#include "eval.h"
+
+#define file position.first
+#define rank position.second
+
+Magic rook_magics[64];
+Magic bishop_magics[64];
+bool use_pext=false;
+
+#ifndef __BMI2__
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+__attribute__((target("bmi2"))) bitboard pext(bitboard b, bitboard mask){
+    return _pext_u64(b, mask);
+}
+#else
+bitboard pext(bitboard b, bitboard mask){
+    bitboard r=0;
+    for(bitboard bit=1; mask; bit<<=1){
+        if(b & mask & -mask)
+            r|=bit;
+        mask&=mask-1;
+    }
+    return r;
+}
+#endif
+#endif
+
+// Squares along one ray up to and including the first occupied one.
+// Only used to fill the lookup tables.
+static bitboard ray_attacks(int direction, int s, bitboard occupied){
+    bitboard a=attacks.ray[direction][s];
+    bitboard blockers=a & occupied;
+    if(blockers){
+        int first=(direction<4 ? __builtin_ctzll(blockers) : 63-__builtin_clzll(blockers));
+        a^=attacks.ray[direction][first];
+    }
+    return a;
+}
+
+static bitboard rook_table[0x19000];
+static bitboard bishop_table[0x1480];
+
+// Fills the attack table of every square for one slider. Without PEXT it
+// searches each square for a magic number that sends every occupancy to
+// a slot holding its attack set. A fixed seed per rank keeps the search
+// repeatable and short.
+static void init_magics(Magic magics[64], bitboard* table, int first_direction){
+    bitboard occupancy[4096], reference[4096];
+    int epoch[4096]={0}, attempt=0;
+    const uint64_t seeds[8]={728, 10316, 55013, 32803, 12281, 15100, 16645, 255};
+    for(int s=0; s<64; s++){
+        Magic& m=magics[s];
+        int col=s%8, row=s/8;
+        uint64_t seed=seeds[row];
+        bitboard edges=((0xFFULL | 0xFFULL << 56) & ~(0xFFULL << 8*row)) | ((0x0101010101010101ULL | 0x8080808080808080ULL) & ~(0x0101010101010101ULL << col));
+        m.mask=0;
+        for(int d=first_direction; d<8; d+=2)
+            m.mask|=attacks.ray[d][s];
+        m.mask&=~edges;
+        int bits=__builtin_popcountll(m.mask);
+        m.shift=64-bits;
+        m.attacks=table;
+        int size=0;
+        bitboard b=0;
+        do{
+            occupancy[size]=b;
+            reference[size]=0;
+            for(int d=first_direction; d<8; d+=2)
+                reference[size]|=ray_attacks(d, s, b);
+            if(use_pext)
+                m.attacks[pext(b, m.mask)]=reference[size];
+            size++;
+            b=(b-m.mask) & m.mask;
+        } while(b);
+        table+=size;
+        if(use_pext)
+            continue;
+        for(int i=0; i<size; ){
+            m.number=0;
+            while(__builtin_popcountll((m.mask*m.number) >> 56)<6){
+                bitboard r=~0ULL;
+                for(int k=0; k<3; k++){
+                    seed^=seed >> 12;
+                    seed^=seed << 25;
+                    seed^=seed >> 27;
+                    r&=seed*0x2545F4914F6CDD1DULL;
+                }
+                m.number=r;
+            }
+            attempt++;
+            for(i=0; i<size; i++){
+                unsigned index=((occupancy[i] & m.mask)*m.number) >> m.shift;
+                if(epoch[index]<attempt){
+                    epoch[index]=attempt;
+                    m.attacks[index]=reference[i];
+                }
+                else if(m.attacks[index]!=reference[i])
+                    break;
+            }
+        }
+    }
+}
+
+static bool magics_ready=[]{
+#if defined(__x86_64__) || defined(__i386__)
+    use_pext=__builtin_cpu_supports("bmi2");
+#endif
+    init_magics(rook_magics, rook_table, 0);
+    init_magics(bishop_magics, bishop_table, 1);
+    return true;
+}();
+
+chessboard:: chessboard(){
+    for(int i=0; i<64; i++)
+        square[i]=no_piece;
+    for(int i=0; i<2; i++){
+        for(int j=0; j<6; j++) pieces[i][j]=0;
+        occupied[i]=0;
+    }
+    all=0;
+    key=0;
+    psq_mg=psq_eg=phase=0;
+    pawn_key=0;
+    halfmove_clock=0;
+}
+
+const MoveList& legal_cache:: moves(chessboard& B){
+    if(!ready || key!=B.key){
+        list.count=0;
+        legal_moves(B, list);
+        key=B.key;
+        ready=true;
+    }
+    return list;
+}
+
+Piece chessboard:: access(pci position){
+    if(file < 'a' || file>'h' || rank<1 || rank>8)
+        throw out_of_range("invalid index");
+    return square[square_index(position)];
+}
+
+// Looks outward from the square for a piece of color by that could capture
+// on it: pawn diagonals, knight jumps, king steps and the sliding rays up
+// to the first piece on each.
+bool chessboard:: is_square_attacked(pci position, Color by){
+    int s=square_index(position);
+    return (attacks.pawn[opponent(by)][s] & pieces[by][pawn])
+        || (attacks.knight[s] & pieces[by][knight])
+        || (attacks.king[s] & pieces[by][king])
+        || (rook_attacks(s, all) & (pieces[by][rook] | pieces[by][queen]))
+        || (bishop_attacks(s, all) & (pieces[by][bishop] | pieces[by][queen]));
+}
+
+/////////////////////////////////////////////////////////
+
+static void pawn_moves(chessboard &b, int s, Color c, MoveList &list){
+    pci position=square_position(s);
+    Color e=opponent(c);
+    bitboard targets=attacks.pawn_push[c][s] & ~b.all;
+    if(targets && rank==(c==white ? 2 : 7))
+        targets|=attacks.pawn_push[c][s+(c==white ? 8 : -8)] & ~b.all;
+    targets|=attacks.pawn[c][s] & b.occupied[e];
+    if(rank==(c==white ? 7 : 2)){
+        while(targets){
+            int to=pop_lsb(targets);
+            for(int t=queen; t>=knight; t--)
+                list.push(Move(s, to, move_promotion, PieceType(t)));
+        }
+        return;
+    }
+    while(targets)
+        list.push(Move(s, pop_lsb(targets)));
+    // en passant: the enemy pawn beside this one has just made a double step
+    if(rank==(c==white ? 5 : 4)){
+        plain_pair<pci, pci> last=b.returnPlayer(e).lastmove;
+        if(last.first.second==(c==white ? 7 : 2) && last.second.second==rank && last.first.first==last.second.first
+           && (last.second.first==file+1 || last.second.first==file-1)
+           && (b.pieces[e][pawn] & 1ULL << square_index(last.second)))
+            list.push(Move(s, square_index({last.second.first, c==white ? 6 : 3}), move_en_passant));
+    }
+}
+
+// Appends the moves the piece on s could make if its king were never in
+// danger; legal_moves() takes out the ones that leave it attacked.
+void moveable_to(chessboard &b, int s, MoveList &list){
+    Piece x=b.at(s);
+    Color c=x.color();
+    bitboard targets;
+    switch(x.type()){
+        case pawn:
+            pawn_moves(b, s, c, list);
+            return;
+        case knight:
+            targets=attacks.knight[s];
+            break;
+        case bishop:
+            targets=bishop_attacks(s, b.all);
+            break;
+        case rook:
+            targets=rook_attacks(s, b.all);
+            break;
+        case queen:
+            targets=rook_attacks(s, b.all) | bishop_attacks(s, b.all);
+            break;
+        default:
+            targets=attacks.king[s];
+    }
+    targets&=~b.occupied[c];
+    while(targets)
+        list.push(Move(s, pop_lsb(targets)));
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+void chessboard:: place(Piece p, pci position){
+    int s=square_index(position);
+    bitboard m=1ULL << s;
+    square[s]=p;
+    pieces[p.color()][p.type()]|=m;
+    key^=zobrist.piece[p.color()][p.type()][s];
+    psq_mg+=piece_square.value[p.color()][p.type()][s].mg;
+    psq_eg+=piece_square.value[p.color()][p.type()][s].eg;
+    phase+=piece_square.phase[p.type()];
+    if(p.type()==pawn)
+        pawn_key^=zobrist.piece[p.color()][pawn][s];
+    occupied[p.color()]|=m;
+    all|=m;
+}
+
+Piece chessboard:: remove(pci position){
+    int s=square_index(position);
+    Piece x=square[s];
+    if(!x.empty()){
+        bitboard m=1ULL << s;
+        pieces[x.color()][x.type()]&=~m;
+        key^=zobrist.piece[x.color()][x.type()][s];
+        psq_mg-=piece_square.value[x.color()][x.type()][s].mg;
+        psq_eg-=piece_square.value[x.color()][x.type()][s].eg;
+        phase-=piece_square.phase[x.type()];
+        if(x.type()==pawn)
+            pawn_key^=zobrist.piece[x.color()][pawn][s];
+        occupied[x.color()]&=~m;
+        all&=~m;
+        square[s]=no_piece;
+    }
+    return x;
+}
+
+ostream& operator << (ostream& out, chessboard& b){
+    for(unsigned i=8; i>=1; i--){   
+        for(char j='a'; j<='h'; j++){
+            char y;
+            Piece p=b.access({j, int(i)});
+            if(!p.empty())
+                y=p.label();
+            else
+                y=' ';
+            out << "|";
+            out << y;
+        }
+        out << "|\n";
+    }
+    return out;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+// Plays a move on the board, castling included (the king moves two files and
+// the rook follows), and passes the turn. Nothing is allocated or freed.
+void chessboard:: make_move(pci initial_position, pci position, Undo &u, char promotion){
+    u.initial_position=initial_position;
+    u.position=position;
+    u.white_player=white_player;
+    u.black_player=black_player;
+    u.to_play=to_play;
+    u.halfmove_clock=halfmove_clock;
+    u.key=key;
+    key^=castling_key()^en_passant_key();
+    Piece x=remove(initial_position);
+    Color c=x.color();
+    u.moved=x;
+    u.captured_position=position;
+    if(x.type()==pawn && initial_position.first!=file && access(position).empty())
+        u.captured_position={file, initial_position.second};
+    u.captured=remove(u.captured_position);
+    halfmove_clock=(x.type()==pawn || !u.captured.empty() ? 0 : halfmove_clock+1);
+    if(promotion!=' ')
+        x=Piece(type_of(promotion), c);
+    place(x, position);
+    returnPlayer(c).lastmove={initial_position, position};
+    if(x.type()==king){
+        returnPlayer(c).king=position;
+        returnPlayer(c).shortcastleright=false;
+        returnPlayer(c).longcastleright=false;
+        if(file-initial_position.first==2 || file-initial_position.first==-2){
+            remove({file=='g' ? 'h' : 'a', rank});
+            place(Piece(rook, c), {file=='g' ? 'f' : 'd', rank});
+        }
+    }
+    else if(x.type()==rook){
+        pci pos1={'h', c==white ? 1 : 8};
+        pci pos2={'a', c==white ? 1 : 8};
+        if(initial_position==pos1)
+            returnPlayer(c).shortcastleright=false;
+        else if(initial_position==pos2)
+            returnPlayer(c).longcastleright=false;
+    }
+    if(!u.captured.empty() && u.captured.type()==rook){
+        Color e=u.captured.color();
+        pci pos1={'h', e==white ? 1 : 8};
+        pci pos2={'a', e==white ? 1 : 8};
+        if(position==pos1)
+            returnPlayer(e).shortcastleright=false;
+        else if(position==pos2)
+            returnPlayer(e).longcastleright=false;
+    }
+    to_play=(to_play==white ? black : white);
+    key^=zobrist.side^castling_key()^en_passant_key();
+    assert(key==compute_key());
+}
+
+void chessboard:: unmake_move(const Undo &u){
+    remove(u.position);
+    place(u.moved, u.initial_position);
+    if(u.moved.type()==king && (u.position.first-u.initial_position.first==2 || u.position.first-u.initial_position.first==-2)){
+        int row=u.position.second;
+        remove({u.position.first=='g' ? 'f' : 'd', row});
+        place(Piece(rook, u.moved.color()), {u.position.first=='g' ? 'h' : 'a', row});
+    }
+    if(!u.captured.empty())
+        place(u.captured, u.captured_position);
+    white_player=u.white_player;
+    black_player=u.black_player;
+    to_play=u.to_play;
+    halfmove_clock=u.halfmove_clock;
+    key=u.key;
+    assert(key==compute_key());
+}
+
+// Passes the turn without moving, for the search's null-move pruning.
+// The en passant chance the opponent left is lost with it.
+void chessboard:: make_null_move(Undo &u){
+    u.captured=no_piece;
+    u.key=key;
+    u.white_player=white_player;
+    u.black_player=black_player;
+    u.to_play=to_play;
+    u.halfmove_clock=halfmove_clock;
+    key^=en_passant_key();
+    returnPlayer(to_play).lastmove={{' ', 0}, {' ', 0}};
+    to_play=opponent(to_play);
+    key^=zobrist.side;
+    assert(key==compute_key());
+}
+
+void chessboard:: unmake_null_move(const Undo &u){
+    white_player=u.white_player;
+    black_player=u.black_player;
+    to_play=u.to_play;
+    halfmove_clock=u.halfmove_clock;
+    key=u.key;
+}
+
+bitboard chessboard:: castling_key(){
+    bitboard k=0;
+    if(white_player.shortcastleright) k^=zobrist.castling[0];
+    if(white_player.longcastleright) k^=zobrist.castling[1];
+    if(black_player.shortcastleright) k^=zobrist.castling[2];
+    if(black_player.longcastleright) k^=zobrist.castling[3];
+    return k;
+}
+
+// The en passant file only counts when the opponent's last move was a
+// double pawn step and a pawn of the side to play stands beside it, so
+// positions that differ in nothing else still hash the same.
+bitboard chessboard:: en_passant_key(){
+    Color e=opponent(to_play);
+    plain_pair<pci, pci> last=returnPlayer(e).lastmove;
+    bool double_step=(last.first.second==2 && last.second.second==4) || (last.first.second==7 && last.second.second==5);
+    if(last.first.first!=last.second.first || !double_step)
+        return 0;
+    int s=square_index(last.second);
+    if(!(pieces[e][pawn] & 1ULL << s))
+        return 0;
+    bitboard beside=0;
+    if(s%8>0)
+        beside|=1ULL << (s-1);
+    if(s%8<7)
+        beside|=1ULL << (s+1);
+    if(!(beside & pieces[to_play][pawn]))
+        return 0;
+    return zobrist.en_passant[last.second.first-'a'];
+}
+
+// The key from scratch, to set it up and to check the incremental one.
+bitboard chessboard:: compute_key(){
+    bitboard k=castling_key()^en_passant_key();
+    if(to_play==black)
+        k^=zobrist.side;
+    for(int c=0; c<2; c++)
+        for(int t=0; t<6; t++){
+            bitboard b=pieces[c][t];
+            while(b)
+                k^=zobrist.piece[c][t][pop_lsb(b)];
+        }
+    return k;
+}
+
+void move(pci initial_position, pci position, chessboard& B){
+    Undo u;
+    B.make_move(initial_position, position, u);
+}
+
+void promote(pci position, char label, Color c, chessboard& b){
+    b.remove(position);
+    b.place(Piece(type_of(label), c), position);
+}
+
+void move_index:: build(chessboard& B, legal_cache* legal){
+    fill(&from[0][0], &from[0][0]+6*64, 0);
+    castle[0]=castle[1]=false;
+    legal_cache local;
+    for(Move m: (legal ? *legal : local).moves(B)){
+        if(m.kind()==move_castling)
+            castle[m.to()<m.from()]=true;
+        else
+            from[B.at(m.from()).type()][m.to()]|=1ULL << m.from();
+    }
+}
+
+// Reads a move the way it is written in algebraic notation: a capture
+// must be marked, a pawn reaching the last rank must say what it becomes,
+// and a file or rank is given only when it tells two pieces apart.
+san_error parse_san(string_view s, chessboard& B, const move_index& index, Move& m){
+    int num=(B.to_play==white ? 1 : 8);
+    if(s=="O-O" || s=="O-O-O"){
+        bool kingside=(s=="O-O");
+        if(!index.castle[!kingside])
+            return san_illegal;
+        m=Move(square_index({'e', num}), square_index({kingside ? 'g' : 'c', num}), move_castling);
+        return san_ok;
+    }
+    char promotion=' ';
+    size_t eq=s.find('=');
+    if(eq!=string_view::npos){
+        if(eq+2!=s.size() || string_view("NBRQ").find(s[eq+1])==string_view::npos)
+            return san_unknown;
+        promotion=s[eq+1];
+        s=s.substr(0, eq);
+    }
+    if(s.size()<2 || s[s.size()-2]<'a' || s[s.size()-2]>'h' || s.back()<'1' || s.back()>'8')
+        return san_unknown;
+    int to=square_index({s[s.size()-2], s.back()-'0'});
+    s.remove_suffix(2);
+    bool capture=(!s.empty() && s.back()=='x');
+    if(capture)
+        s.remove_suffix(1);
+    PieceType t=pawn;
+    if(!s.empty() && s[0]>='A' && s[0]<='Z'){
+        if(string_view("NBRQK").find(s[0])==string_view::npos)
+            return san_unknown;
+        t=type_of(s[0]);
+        s.remove_prefix(1);
+    }
+    int col=-1, row=-1;
+    for(char x: s){
+        if(x>='a' && x<='h' && col<0 && row<0)
+            col=x-'a';
+        else if(x>='1' && x<='8' && row<0)
+            row=x-'1';
+        else
+            return san_unknown;
+    }
+    bitboard candidates=index.from[t][to];
+    const bitboard file_a=0x0101010101010101ULL, rank_1=0xFFULL;
+    if(t==pawn){
+        // "e4" moves along the file, "exd5" names the file it comes from
+        if(capture!=(col>=0) || row>=0 || col==to%8)
+            return san_unknown;
+        candidates&=file_a << (capture ? col : to%8);
+        if((promotion!=' ')!=(to/8==0 || to/8==7))
+            return san_illegal;
+    }
+    else{
+        if(promotion!=' ')
+            return san_unknown;
+        if(capture!=((B.all >> to) & 1))
+            return san_illegal;
+        if(col>=0){
+            if(!(candidates & ~(file_a << col)))
+                return san_unknown;
+            candidates&=file_a << col;
+        }
+        if(row>=0){
+            if(!(index.from[t][to] & ~(rank_1 << 8*row)))
+                return san_unknown;
+            candidates&=rank_1 << 8*row;
+        }
+    }
+    if(!candidates)
+        return san_illegal;
+    if(candidates & (candidates-1))
+        return san_ambiguous;
+    int from=pop_lsb(candidates);
+    if(promotion!=' ')
+        m=Move(from, to, move_promotion, type_of(promotion));
+    else if(t==pawn && !(B.all >> to & 1) && from%8!=to%8)
+        m=Move(from, to, move_en_passant);
+    else
+        m=Move(from, to);
+    return san_ok;
+}
+
+san_error read_san(string_view s, chessboard& B, Move& m, legal_cache* legal){
+    move_index index;
+    index.build(B, legal);
+    return parse_san(s, B, index, m);
+}
+
+san_error apply_san(string_view s, chessboard& B){
+    Move m;
+    san_error e=read_san(s, B, m);
+    if(e!=san_ok)
+        return e;
+    Color c=B.to_play;
+    move(m.initial_position(), m.position(), B);
+    if(m.kind()==move_promotion)
+        promote(m.position(), m.promotion(), c, B);
+    return san_ok;
+}
+
+bool understand_move(string_view s, chessboard &B){
+    return apply_san(s, B)==san_ok;
+}
+
+// Castling rights are only lost by moving or losing the king or rook, so
+// while one is kept both pieces are still on their original squares.
+// The king may not start on, cross or land on an attacked square.
+bool castle_allowed(chessboard& B, bool kingside){
+    Color c=B.to_play;
+    Color e=opponent(c);
+    int num=(c==white ? 1 : 8);
+    if(kingside)
+        return B.returnPlayer(c).shortcastleright==true
+            && B.access({'f', num}).empty() && B.access({'g', num}).empty()
+            && !B.is_square_attacked({'e', num}, e) && !B.is_square_attacked({'f', num}, e) && !B.is_square_attacked({'g', num}, e);
+    else
+        return B.returnPlayer(c).longcastleright==true
+            && B.access({'d', num}).empty() && B.access({'c', num}).empty() && B.access({'b', num}).empty()
+            && !B.is_square_attacked({'e', num}, e) && !B.is_square_attacked({'d', num}, e) && !B.is_square_attacked({'c', num}, e);
+}
+
+// Every legal move of the side to play. Only a king move, en passant, or
+// a move by a piece on a line from its own king can leave that king
+// attacked, unless it is in check already; the other moves are kept
+// without being tried.
+void legal_moves(chessboard& B, MoveList& list){
+    Color c=B.to_play;
+    int num=(c==white ? 1 : 8);
+    pci k=B.returnPlayer(c).king;
+    int ks=square_index(k);
+    bool in_check=B.is_square_attacked(k, opponent(c));
+    bitboard lines=rook_attacks(ks, B.all) | bishop_attacks(ks, B.all);
+    bitboard own=B.occupied[c];
+    while(own){
+        int s=pop_lsb(own);
+        int first=list.size();
+        moveable_to(B, s, list);
+        bool safe=!in_check && B.at(s).type()!=king && !(lines >> s & 1);
+        int kept=first;
+        for(int i=first; i<list.size(); i++){
+            Move m=list[i];
+            bool g=true;
+            if(!safe || m.kind()==move_en_passant){
+                Undo u;
+                B.make_move(m.initial_position(), m.position(), u);
+                g=!B.is_square_attacked(B.returnPlayer(c).king, opponent(c));
+                B.unmake_move(u);
+            }
+            if(g)
+                list[kept++]=m;
+        }
+        list.count=kept;
+    }
+    if(castle_allowed(B, true))
+        list.push(Move(square_index({'e', num}), square_index({'g', num}), move_castling));
+    if(castle_allowed(B, false))
+        list.push(Move(square_index({'e', num}), square_index({'c', num}), move_castling));
+}
+
+// Algebraic notation as understand_move reads it: no check signs, and the
+// file (or else the rank) only when another piece could go there too.
+string move_to_san(chessboard& B, Move m, legal_cache* legal){
+    pci from=m.initial_position(), to=m.position();
+    Piece x=B.access(from);
+    string s;
+    if(m.kind()==move_castling)
+        return to.first=='g' ? "O-O" : "O-O-O";
+    bool capture=!B.access(to).empty();
+    if(x.type()==pawn){
+        if(from.first!=to.first)
+            s=s+from.first+'x';
+    }
+    else{
+        s+=x.label();
+        bool other=false, same_file=false, same_rank=false;
+        legal_cache local;
+        for(Move n: (legal ? *legal : local).moves(B)){
+            pci p=n.initial_position();
+            if(n.to()==m.to() && n.from()!=m.from() && B.access(p)==x){
+                other=true;
+                same_file=same_file || p.first==from.first;
+                same_rank=same_rank || p.second==from.second;
+            }
+        }
+        if(other && (!same_file || same_rank))
+            s+=from.first;
+        if(other && same_file)
+            s+=char('0'+from.second);
+        if(capture)
+            s+='x';
+    }
+    s+=to.first;
+    s+=char('0'+to.second);
+    if(m.kind()==move_promotion)
+        s=s+'='+m.promotion();
+    return s;
+}
+
+// Neither side can checkmate: no pawns, rooks or queens, and at most one
+// knight or bishop, or only bishops that all stand on one color.
+bool insufficient_material(chessboard& B){
+    bitboard heavy=0, knights=0, bishops=0;
+    for(int c=0; c<2; c++){
+        heavy|=B.pieces[c][pawn] | B.pieces[c][rook] | B.pieces[c][queen];
+        knights|=B.pieces[c][knight];
+        bishops|=B.pieces[c][bishop];
+    }
+    if(heavy)
+        return false;
+    if(popcount(knights | bishops)<=1)
+        return true;
+    const bitboard light=0x55AA55AA55AA55AAULL;
+    return !knights && (!(bishops & light) || !(bishops & ~light));
+}
+
+// 1 checkmate, -1 stalemate, -2 seventy-five moves without a capture or
+// pawn move, -3 not enough material to checkmate: the game is over.
+// 2 after fifty such moves, when either player may claim a draw but the
+// game goes on until one does; 0 otherwise. Mate comes first, even on
+// the move that reaches fifty or seventy-five.
+// Repetitions need the game's history, see game_history::repetitions().
+int check_state(chessboard& B, legal_cache* legal){
+    Color c=B.to_play;
+    legal_cache local;
+    if((legal ? *legal : local).moves(B).empty()){
+        if(B.is_square_attacked(B.returnPlayer(c).king, opponent(c)))
+            return 1;
+        else
+            return -1;
+    }
+    if(B.halfmove_clock>=150)
+        return -2;
+    if(insufficient_material(B))
+        return -3;
+    return B.halfmove_clock>=100 ? 2 : 0;
+}
+// Returns false, with the board left empty, for a FEN that does not
+// describe a position: the ranks must each cover eight files, each side
+// have one king, no pawn stand on the first or last rank and the side
+// that just moved not be left in check. A castling right needs its king
+// and rook at home, and an en passant square the pawn that just passed
+// it. The move counters may be left out, as in EPD, and whatever comes
+// after the fields is ignored.
+bool chessboard:: setup(string_view s){
+    *this=chessboard();
+    auto fail=[this]{
+        *this=chessboard();
+        return false;
+    };
+    string_view field[5];
+    int fields=0;
+    while(fields<5){
+        size_t first=s.find_first_not_of(' ');
+        if(first==string_view::npos)
+            break;
+        s.remove_prefix(first);
+        size_t space=min(s.find(' '), s.size());
+        field[fields++]=s.substr(0, space);
+        s.remove_prefix(space);
+    }
+    if(fields<4)
+        return fail();
+
+    char i='a';
+    int j=8;
+    for(char x: field[0]){
+        if(x=='/'){
+            if(i!='i' || j==1)
+                return fail();
+            j--;
+            i='a';
+        }
+        else if(x>='1' && x<='8'){
+            i+=x-'0';
+            if(i>'i')
+                return fail();
+        }
+        else{
+            size_t t=string_view("pnbrqk").find(tolower(x));
+            if(t==string_view::npos || i>'h' || (t==pawn && (j==1 || j==8)))
+                return fail();
+            Color c=(isupper(x) ? white : black);
+            place(Piece(PieceType(t), c), {i, j});
+            if(t==king)
+                returnPlayer(c).king={i, j};
+            i++;
+        }
+    }
+    if(j!=1 || i!='i' || popcount(pieces[white][king])!=1 || popcount(pieces[black][king])!=1)
+        return fail();
+
+    if(field[1]=="w")
+        to_play=white;
+    else if(field[1]=="b")
+        to_play=black;
+    else
+        return fail();
+
+    if(field[2]!="-")
+        for(char x: field[2]){
+            size_t k=string_view("KQkq").find(x);
+            if(k==string_view::npos)
+                return fail();
+            Color c=(k<2 ? white : black);
+            int row=(c==white ? 1 : 8);
+            bool& right=(k%2==0 ? returnPlayer(c).shortcastleright : returnPlayer(c).longcastleright);
+            if(right || access({'e', row})!=Piece(king, c) || access({k%2==0 ? 'h' : 'a', row})!=Piece(rook, c))
+                return fail();
+            right=true;
+        }
+
+    if(field[3]!="-"){
+        // The square the pawn passed, behind it as the side to play sees it.
+        Color c=opponent(to_play);
+        int row=(c==white ? 3 : 6), step=(c==white ? 1 : -1);
+        if(field[3].size()!=2 || field[3][0]<'a' || field[3][0]>'h' || field[3][1]!='0'+row)
+            return fail();
+        char f=field[3][0];
+        if(access({f, row+step})!=Piece(pawn, c) || !access({f, row}).empty() || !access({f, row-step}).empty())
+            return fail();
+        returnPlayer(c).lastmove={{f, row-step}, {f, row+step}};
+    }
+
+    if(fields==5 && field[4].size()<=4 && all_of(field[4].begin(), field[4].end(), ::isdigit))
+        for(char x: field[4])
+            halfmove_clock=10*halfmove_clock+x-'0';
+
+    Color e=opponent(to_play);
+    if(is_square_attacked(returnPlayer(e).king, to_play))
+        return fail();
+    key=compute_key();
+    return true;
+}
@@ -0,0 +1,377 @@
+/* Rules of the game: the position, the pieces and the move parser.
+Shared by the interactive tool, the perft mode and the benchmarks.
+*/
+
+#ifndef BOARD_H
+#define BOARD_H
+
+#include <iostream>
+#include <utility> 
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// Like pair<>, but with the trivial copy and assignment that a trivially
+// copyable chessboard needs; std::pair's assignment is user-provided.
+template<class A, class B>
+struct plain_pair{
+    A first;
+    B second;
+    bool operator==(const plain_pair& p) const {return first==p.first && second==p.second;}
+    bool operator!=(const plain_pair& p) const {return !(*this==p);}
+};
+
+#define pci plain_pair<char, int>
+#define def "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq -"
+
+enum Color{white, black};
+enum PieceType{pawn, knight, bishop, rook, queen, king};
+
+// One bit per square, a1 is bit 0, b1 is bit 1, ..., h8 is bit 63.
+typedef uint64_t bitboard;
+
+inline int square_index(pci position){
+    return (position.first-'a')+8*(position.second-1);
+}
+
+inline pci square_position(int s){
+    return {char('a'+s%8), 1+s/8};
+}
+
+// The number of squares in b. Without a POPCNT target the builtin is a
+// library call, so count the bits in parallel instead.
+inline int popcount(bitboard b){
+#ifdef __POPCNT__
+    return __builtin_popcountll(b);
+#else
+    b-=b >> 1 & 0x5555555555555555ULL;
+    b=(b & 0x3333333333333333ULL)+(b >> 2 & 0x3333333333333333ULL);
+    b=(b+(b >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return (b*0x0101010101010101ULL) >> 56;
+#endif
+}
+
+// Returns the index of the lowest set square and clears it from b.
+inline int pop_lsb(bitboard &b){
+    int s=__builtin_ctzll(b);
+    b&=b-1;
+    return s;
+}
+
+constexpr int knight_steps[8][2]={{2, 1}, {1, 2}, {-1, 2}, {-2, 1}, {-2, -1}, {-1, -2}, {1, -2}, {2, -1}};
+// Also the ray directions: east, north-east, north, north-west, then the
+// same four reversed. The first four go towards higher square indices.
+constexpr int king_steps[8][2]={{1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1}};
+
+// Target squares of every piece from every square, built at compile time.
+struct attack_tables{
+    bitboard knight[64];
+    bitboard king[64];
+    bitboard pawn[2][64];        // the two diagonal captures
+    bitboard pawn_push[2][64];   // the square in front
+    bitboard ray[8][64];         // every square in one direction up to the edge
+};
+
+constexpr attack_tables make_attack_tables(){
+    attack_tables t{};
+    for(int s=0; s<64; s++){
+        int col=s%8, row=s/8;
+        for(int i=0; i<8; i++){
+            int x=col+knight_steps[i][0], y=row+knight_steps[i][1];
+            if(x>=0 && x<8 && y>=0 && y<8)
+                t.knight[s]|=1ULL << (x+8*y);
+            x=col+king_steps[i][0];
+            y=row+king_steps[i][1];
+            if(x>=0 && x<8 && y>=0 && y<8)
+                t.king[s]|=1ULL << (x+8*y);
+            while(x>=0 && x<8 && y>=0 && y<8){
+                t.ray[i][s]|=1ULL << (x+8*y);
+                x+=king_steps[i][0];
+                y+=king_steps[i][1];
+            }
+        }
+        if(row<7){
+            t.pawn_push[white][s]=1ULL << (s+8);
+            if(col>0) t.pawn[white][s]|=1ULL << (s+7);
+            if(col<7) t.pawn[white][s]|=1ULL << (s+9);
+        }
+        if(row>0){
+            t.pawn_push[black][s]=1ULL << (s-8);
+            if(col>0) t.pawn[black][s]|=1ULL << (s-9);
+            if(col<7) t.pawn[black][s]|=1ULL << (s-7);
+        }
+    }
+    return t;
+}
+
+inline constexpr attack_tables attacks=make_attack_tables();
+
+// Rook and bishop attacks are looked up in a table per square, indexed by
+// the pieces standing on the relevant squares (the rays minus the edge).
+// The index is pext(occupied, mask) on CPUs with BMI2, and otherwise the
+// magic multiplication ((occupied & mask) * number) >> shift. The tables
+// are filled when the program starts, in board.cpp.
+struct Magic{
+    bitboard mask;
+    bitboard number;
+    int shift;
+    bitboard* attacks;
+};
+
+extern Magic rook_magics[64];
+extern Magic bishop_magics[64];
+extern bool use_pext;
+
+#ifdef __BMI2__
+inline bitboard pext(bitboard b, bitboard mask){
+    return _pext_u64(b, mask);
+}
+#else
+bitboard pext(bitboard b, bitboard mask);
+#endif
+
+inline bitboard slider_attacks(const Magic& m, bitboard occupied){
+    if(use_pext)
+        return m.attacks[pext(occupied, m.mask)];
+    return m.attacks[((occupied & m.mask)*m.number) >> m.shift];
+}
+
+inline bitboard rook_attacks(int s, bitboard occupied){
+    return slider_attacks(rook_magics[s], occupied);
+}
+
+inline bitboard bishop_attacks(int s, bitboard occupied){
+    return slider_attacks(bishop_magics[s], occupied);
+}
+
+// Random keys for the Zobrist hash of a position, made at compile time.
+struct zobrist_keys{
+    bitboard piece[2][6][64];
+    bitboard castling[4];     // white short, white long, black short, black long
+    bitboard en_passant[8];   // by file
+    bitboard side;            // black to play
+};
+
+constexpr zobrist_keys make_zobrist_keys(){
+    zobrist_keys z{};
+    uint64_t x=0x2D358DCCAA6C78A5ULL;
+    auto next=[&x](){
+        // splitmix64
+        uint64_t r=(x+=0x9E3779B97F4A7C15ULL);
+        r=(r^(r >> 30))*0xBF58476D1CE4E5B9ULL;
+        r=(r^(r >> 27))*0x94D049BB133111EBULL;
+        return r^(r >> 31);
+    };
+    for(int c=0; c<2; c++)
+        for(int t=0; t<6; t++)
+            for(int s=0; s<64; s++)
+                z.piece[c][t][s]=next();
+    for(int i=0; i<4; i++)
+        z.castling[i]=next();
+    for(int i=0; i<8; i++)
+        z.en_passant[i]=next();
+    z.side=next();
+    return z;
+}
+
+inline constexpr zobrist_keys zobrist=make_zobrist_keys();
+
+inline Color opponent(Color c){
+    return c==white ? black : white;
+}
+
+inline PieceType type_of(char label){
+    switch(label){
+        case 'p': return pawn;
+        case 'N': return knight;
+        case 'B': return bishop;
+        case 'R': return rook;
+        case 'Q': return queen;
+        default: return king;
+    }
+}
+
+// A move in 16 bits: from square, to square, the piece a promoting pawn
+// becomes, and the kind of move. 0 is no move, since a1 to a1 is none.
+enum MoveKind{move_normal, move_promotion, move_en_passant, move_castling};
+
+struct Move{
+    uint16_t data;
+    Move()=default;
+    constexpr Move(int from, int to, MoveKind kind=move_normal, PieceType promoted=knight)
+        : data(from | to << 6 | (promoted-knight) << 12 | kind << 14) {}
+    int from() const {return data & 63;}
+    int to() const {return data >> 6 & 63;}
+    MoveKind kind() const {return MoveKind(data >> 14);}
+    PieceType promoted() const {return PieceType(knight+(data >> 12 & 3));}
+    // the new piece's label, or ' '
+    char promotion() const {return kind()==move_promotion ? "NBRQ"[data >> 12 & 3] : ' ';}
+    pci initial_position() const {return square_position(from());}
+    pci position() const {return square_position(to());}
+    bool operator==(Move m) const {return data==m.data;}
+    bool operator!=(Move m) const {return data!=m.data;}
+};
+
+// The moves of one position, on the stack of whoever asked for them: no
+// position has more than 218.
+struct MoveList{
+    Move moves[256];
+    int count=0;
+    void push(Move m){moves[count++]=m;}
+    int size() const {return count;}
+    bool empty() const {return count==0;}
+    Move& operator[](int i){return moves[i];}
+    const Move& operator[](int i) const {return moves[i];}
+    Move* begin(){return moves;}
+    Move* end(){return moves+count;}
+    const Move* begin() const {return moves;}
+    const Move* end() const {return moves+count;}
+};
+
+// A piece in one byte: its type plus one, and 8 more when it is black.
+// 0 is an empty square, so the board itself is a plain array of these.
+struct Piece{
+    uint8_t code;
+    Piece()=default;
+    constexpr Piece(PieceType t, Color c): code(uint8_t(t+1+8*c)) {}
+    bool empty() const {return code==0;}
+    PieceType type() const {return PieceType((code & 7)-1);}
+    Color color() const {return Color(code >> 3);}
+    char label() const {return "pNBRQK"[type()];}
+    bool operator==(Piece p) const {return code==p.code;}
+    bool operator!=(Piece p) const {return code!=p.code;}
+};
+
+inline constexpr Piece no_piece=Piece();
+
+class chessboard;
+struct Undo;
+class game_history;
+struct search_limits;
+void move(pci initial_position, pci position, chessboard& B);
+
+class chessboard{
+public:
+    chessboard();
+    Piece access(pci position);
+    Piece at(int s) const {return square[s];}
+    void place(Piece p, pci position);
+    Piece remove(pci position);
+    bool is_square_attacked(pci position, Color by);
+    bitboard castling_key();
+    bitboard en_passant_key();
+    bitboard compute_key();
+    void make_move(pci initial_position, pci position, Undo &u, char promotion=' ');
+    void make_move(Move m, Undo &u){
+        make_move(m.initial_position(), m.position(), u, m.promotion());
+    }
+    void unmake_move(const Undo &u);
+    void make_null_move(Undo &u);
+    void unmake_null_move(const Undo &u);
+    bool setup(string_view s=def);     // false for a malformed FEN
+    friend ostream& operator << (ostream& out, chessboard& b); 
+    class Player{
+    public:
+        Player() {}
+        pci king;
+        plain_pair<pci, pci> lastmove={{' ', 0}, {' ', 0}};
+        bool shortcastleright=false;
+        bool longcastleright=false;
+    };
+    Player white_player;
+    Player black_player;
+
+    Player& returnPlayer(Color c){
+        if(c==white)
+            return white_player;
+        else
+            return black_player;
+    }
+    bool command(string s, ostream& out, bool render, game_history& history, search_limits& limits);
+    bool play(istream& in, ostream& out, bool render, game_history& history, search_limits& limits);
+    Color to_play;
+    int halfmove_clock;    // plies since the last capture or pawn move
+
+    // The position itself: one set per color and piece type, plus occupancy,
+    // and square[] to look up what stands on a square.
+    bitboard pieces[2][6];
+    bitboard occupied[2];
+    bitboard all;
+
+    // Zobrist hash of the pieces, side to play, castling rights and en
+    // passant file. place() and remove() keep the piece part up to date,
+    // make_move() the rest, and setup() computes it from scratch.
+    bitboard key;
+
+    // Material and piece-square values summed for both phases of the game,
+    // white minus black, the phase itself, and a key of the pawns alone,
+    // kept up to date by place() and remove() like the key. See eval.h.
+    int psq_mg, psq_eg;
+    int phase;
+    bitboard pawn_key;
+
+private:
+    Piece square[64];
+};
+
+// Nothing on the board is owned elsewhere, so a copy is a plain memcpy.
+static_assert(is_trivially_copyable_v<chessboard>);
+
+// What make_move() changed, so that unmake_move() can put it back.
+// moved is the piece as it was before, a pawn if it promoted.
+struct Undo{
+    pci initial_position;
+    pci position;
+    Piece moved;
+    Piece captured;
+    pci captured_position;
+    bitboard key;
+    chessboard::Player white_player;
+    chessboard::Player black_player;
+    Color to_play;
+    int halfmove_clock;
+};
+
+void moveable_to(chessboard &b, int s, MoveList &list);
+void promote(pci position, char label, Color c, chessboard& b);
+
+// The legal moves of the last position asked about, kept with its key.
+// A game keeps one in its history, so that the moves check_state() works
+// out after a move serve again to read the next one; the functions below
+// that take one work the moves out afresh without it.
+struct legal_cache{
+    MoveList list;
+    bitboard key=0;
+    bool ready=false;
+    const MoveList& moves(chessboard& B);
+};
+
+// The legal moves of one position by piece type and destination, so that
+// a move in algebraic notation resolves with a few mask operations.
+struct move_index{
+    bitboard from[6][64];   // from[t][s]: squares a piece of type t can move from to s
+    bool castle[2];         // kingside, queenside
+    void build(chessboard& B, legal_cache* legal=nullptr);
+};
+
+enum san_error{san_ok, san_unknown, san_illegal, san_ambiguous};
+
+san_error parse_san(string_view s, chessboard& B, const move_index& index, Move& m);
+san_error read_san(string_view s, chessboard& B, Move& m, legal_cache* legal=nullptr);
+san_error apply_san(string_view s, chessboard& B);
+bool understand_move(string_view s, chessboard &B);
+bool insufficient_material(chessboard& B);
+int check_state(chessboard& B, legal_cache* legal=nullptr);
+bool castle_allowed(chessboard& B, bool kingside);
+void legal_moves(chessboard& B, MoveList& list);
+string move_to_san(chessboard& B, Move m, legal_cache* legal=nullptr);
+
+#endif
@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <random>
+#include "book.h"
+
+static uint64_t big_endian(const char* p, int bytes){
+    uint64_t x=0;
+    for(int i=0; i<bytes; i++)
+        x=x << 8 | (unsigned char)p[i];
+    return x;
+}
+
+static string keys_path(const string& path){
+    size_t slash=path.find_last_of('/');
+    return (slash==string::npos ? "" : path.substr(0, slash+1))+"polyglot.keys";
+}
+
+opening_book:: opening_book(const string& path) : file(path, false){
+    mapped_file keys(keys_path(path));
+    string_view k=keys.view();
+    if(k.size()!=sizeof(random))
+        return;
+    for(int i=0; i<781; i++)
+        random[i]=big_endian(k.data()+8*i, 8);
+    keys_loaded=true;
+}
+
+// Polyglot numbers the pieces black pawn, white pawn, black knight, ...
+// and the squares as we do, a1 to h8.
+bitboard opening_book:: key(chessboard& B) const{
+    bitboard k=0;
+    for(int c=0; c<2; c++)
+        for(int t=0; t<6; t++){
+            bitboard b=B.pieces[c][t];
+            while(b)
+                k^=random[64*(2*t+(c==white))+pop_lsb(b)];
+        }
+    if(B.white_player.shortcastleright) k^=random[768];
+    if(B.white_player.longcastleright) k^=random[769];
+    if(B.black_player.shortcastleright) k^=random[770];
+    if(B.black_player.longcastleright) k^=random[771];
+    // Like ours, the en passant file only counts when a pawn can take.
+    if(B.en_passant_key())
+        k^=random[772+B.returnPlayer(opponent(B.to_play)).lastmove.second.first-'a'];
+    if(B.to_play==white)
+        k^=random[780];
+    return k;
+}
+
+// A book move is the to square in bits 0-5, the from square in bits 6-11
+// and the promotion, 1 for a knight up to 4 for a queen, in bits 12-14.
+// Castling is written as the king taking its own rook.
+static Move book_to_move(chessboard& B, unsigned m){
+    int to=m & 63, from=m >> 6 & 63, promoted=m >> 12 & 7;
+    if(!B.at(from).empty() && B.at(from).type()==king && abs(to%8-from%8)>1)
+        to=from+(to>from ? 2 : -2);
+    MoveList list;
+    legal_moves(B, list);
+    for(Move l : list){
+        if(l.from()!=from || l.to()!=to)
+            continue;
+        if(promoted==0 ? l.kind()!=move_promotion : l.kind()==move_promotion && l.promoted()==knight+promoted-1)
+            return l;
+    }
+    return Move();
+}
+
+void opening_book:: probe(chessboard& B, vector<book_move>& moves) const{
+    moves.clear();
+    if(!is_open())
+        return;
+    string_view v=file.view();
+    const char* entries=v.data();
+    size_t lo=0, hi=v.size()/16;
+    bitboard k=key(B);
+    while(lo<hi){
+        size_t mid=lo+(hi-lo)/2;
+        if(big_endian(entries+16*mid, 8)<k)
+            lo=mid+1;
+        else
+            hi=mid;
+    }
+    for(size_t i=lo; i<v.size()/16 && big_endian(entries+16*i, 8)==k; i++){
+        Move m=book_to_move(B, big_endian(entries+16*i+8, 2));
+        if(m!=Move())
+            moves.push_back({m, int(big_endian(entries+16*i+10, 2))});
+    }
+    stable_sort(moves.begin(), moves.end(), [](const book_move& a, const book_move& b){
+        return a.weight>b.weight;
+    });
+}
+
+Move opening_book:: pick(chessboard& B) const{
+    vector<book_move> moves;
+    probe(B, moves);
+    if(moves.empty())
+        return Move();
+    long total=0;
+    for(const book_move& m : moves)
+        total+=m.weight;
+    if(total==0)
+        return moves[0].move;
+    thread_local mt19937_64 rng(random_device{}());
+    long r=uniform_int_distribution<long>(0, total-1)(rng);
+    for(const book_move& m : moves){
+        if(r<m.weight)
+            return m.move;
+        r-=m.weight;
+    }
+    return moves[0].move;
+}
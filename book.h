@@ -0,0 +1,45 @@
+/* Opening book: reads Polyglot .bin books, to suggest and check opening
+moves.
+
+A book is a file of 16-byte entries sorted by position key: the key,
+the move, a weight and a learn field, all big-endian. The file is
+mapped, not read, so opening even a book of gigabytes costs the same,
+and a probe is a binary search that only touches the few pages on its
+path. Nothing changes after opening, so any number of games may probe
+one book at once.
+
+The key of a position is Polyglot's own, the XOR of entries of its
+781-value Random64 table for the pieces, castling rights, en passant
+file and side to play. The table is read from polyglot.keys next to the
+book, the 781 values as 8-byte big-endian numbers in Polyglot's order.
+book_test checks how key() combines them, and, given the real table,
+the keys Polyglot documents.
+*/
+
+#ifndef BOOK_H
+#define BOOK_H
+
+#include "board.h"
+#include "pgn.h"
+
+struct book_move{
+    Move move;
+    int weight;
+};
+
+class opening_book{
+    mapped_file file;
+    bitboard random[781];
+    bool keys_loaded=false;
+public:
+    explicit opening_book(const string& path);
+    bool is_open() const {return keys_loaded && file.is_open();}
+    bitboard key(chessboard& B) const;
+    // The book moves of the position that are legal in it, heaviest first.
+    void probe(chessboard& B, vector<book_move>& moves) const;
+    // A book move chosen at random in proportion to its weight, or Move()
+    // out of book.
+    Move pick(chessboard& B) const;
+};
+
+#endif
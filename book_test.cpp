@@ -0,0 +1,134 @@
+/* Checks opening_book::key on the positions Polyglot's book format
+documentation lists, which between them use pieces of every kind,
+castling rights lost, en passant files that count and ones that do not.
+
+usage: book_test <directory with polyglot.keys> [scratch directory]
+
+The layout of the key is always checked: a table of random values is
+written to polyglot.keys in a book_test.keys directory under the scratch
+directory (the current one by default), and the key of every position,
+reached by playing its moves and set up from its FEN, must be the XOR
+of the entries the format assigns to what the FEN shows. When the first
+directory holds the real table, the keys must also be the ones the
+documentation gives. Exits with 1 on a wrong key.
+*/
+
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include "book.h"
+
+struct known_key{
+    const char* moves;
+    const char* fen;
+    bitboard key;
+};
+
+const known_key known[]={
+    {"", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 0x463b96181691fc9c},
+    {"e4", "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1", 0x823c9b50fd114196},
+    {"e4 d5", "rnbqkbnr/ppp1pppp/8/3p4/4P3/8/PPPP1PPP/RNBQKBNR w KQkq d6 0 2", 0x0756b94461c50fb0},
+    {"e4 d5 e5", "rnbqkbnr/ppp1pppp/8/3pP3/8/8/PPPP1PPP/RNBQKBNR b KQkq - 0 2", 0x662fafb965db29d4},
+    {"e4 d5 e5 f5", "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3", 0x22a48b5a8e47ff78},
+    {"e4 d5 e5 f5 Ke2", "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR b kq - 0 3", 0x652a607ca3f242c1},
+    {"e4 d5 e5 f5 Ke2 Kf7", "rnbq1bnr/ppp1pkpp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR w - - 0 4", 0x00fdd303c946bdd9},
+    {"a4 b5 h4 b4 c4", "rnbqkbnr/p1pppppp/8/8/PpP4P/8/1P1PPPP1/RNBQKBNR b KQkq c3 0 3", 0x3c8123ea7b067637},
+    {"a4 b5 h4 b4 c4 bxc3 Ra3", "rnbqkbnr/p1pppppp/8/8/P6P/R1p5/1P1PPPP1/1NBQKBNR b Kkq - 0 4", 0x5c3f9b829b279560},
+};
+
+// The key the format gives the FEN, worked out from its text alone.
+static bitboard expected_key(string_view fen, const bitboard random[781]){
+    const string_view kinds="pPnNbBrRqQkK";
+    bitboard k=0;
+    int rank=7, file=0;
+    size_t i=0;
+    for(; fen[i]!=' '; i++){
+        if(fen[i]=='/')
+            rank--, file=0;
+        else if(isdigit(fen[i]))
+            file+=fen[i]-'0';
+        else
+            k^=random[64*kinds.find(fen[i])+8*rank+file++];
+    }
+    bool white_to_play=(fen[++i]=='w');
+    for(i+=2; fen[i]!=' '; i++)
+        if(fen[i]!='-')
+            k^=random[768+string_view("KQkq").find(fen[i])];
+    // The en passant file counts only if a pawn to play stands next to it.
+    if(fen[++i]!='-'){
+        int f=fen[i]-'a';
+        string_view rows=fen.substr(0, fen.find(' '));
+        string row;
+        for(int r=0; r<(white_to_play ? 3 : 4); r++)
+            rows.remove_prefix(rows.find('/')+1);
+        for(char c: rows.substr(0, rows.find('/')))
+            row+=(isdigit(c) ? string(c-'0', '.') : string(1, c));
+        char pawn=(white_to_play ? 'P' : 'p');
+        if((f>0 && row[f-1]==pawn) || (f<7 && row[f+1]==pawn))
+            k^=random[772+f];
+    }
+    if(white_to_play)
+        k^=random[780];
+    return k;
+}
+
+// The key of each position, played from the start and set up from its
+// FEN, against want(position). Returns the number of wrong keys.
+template<class F>
+static int check(const opening_book& book, const char* table, F want){
+    int wrong=0;
+    for(const known_key& k: known){
+        chessboard B;
+        B.setup();
+        string_view moves=k.moves, m;
+        while(!moves.empty()){
+            size_t space=moves.find(' ');
+            m=moves.substr(0, space);
+            moves=(space==string_view::npos ? "" : moves.substr(space+1));
+            if(!understand_move(m, B)){
+                cout << "cannot play " << m << " after \"" << k.moves << "\"" << endl;
+                return size(known);
+            }
+        }
+        chessboard S;
+        S.setup(k.fen);
+        bitboard played=book.key(B), set_up=book.key(S), w=want(k);
+        if(played!=w || set_up!=w){
+            cout << hex << table << " table, after \"" << k.moves << "\": " << played << " played, "
+                 << set_up << " set up, not " << w << dec << endl;
+            wrong++;
+        }
+    }
+    cout << table << " table: " << size(known)-wrong << " of " << size(known) << " keys right" << endl;
+    return wrong;
+}
+
+int main(int argc, char* argv[]){
+    if(argc<2){
+        cout << "usage: book_test <directory with polyglot.keys> [scratch directory]" << endl;
+        return 1;
+    }
+    string dir=argv[1];
+    filesystem::path scratch=filesystem::path(argc>2 ? argv[2] : ".")/"book_test.keys";
+    filesystem::create_directories(scratch);
+    bitboard random[781];
+    {
+        mt19937_64 rng(1);
+        ofstream keys(scratch/"polyglot.keys", ios::binary);
+        for(bitboard& r: random){
+            r=rng();
+            for(int b=56; b>=0; b-=8)
+                keys.put(char(r >> b));
+        }
+    }
+    opening_book test_book((scratch/"book.bin").string());
+    int wrong=check(test_book, "random", [&](const known_key& k){ return expected_key(k.fen, random); });
+
+    if(!mapped_file(dir+"/polyglot.keys").is_open())
+        cout << "no polyglot.keys in " << dir << ", the documented keys are not checked" << endl;
+    else{
+        opening_book book(dir+"/book.bin");
+        wrong+=check(book, "Polyglot", [](const known_key& k){ return k.key; });
+    }
+    return wrong ? 1 : 0;
+}
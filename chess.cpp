@@ -11,1050 +11,439 @@ You can choose a position by specifying an initial setup of the pieces with FEN
 
 Here, in order to see what you do, the chessboard gets printed after each move. You can disable that to practice blindfold chess understanding.
 
-Although there is still some work to be done as far as draw rules and undo option is concerned, the game follows every rule, even the complicated ones like en passant, castling, promotion and their prerequisites. 
+The game follows every rule, even the complicated ones like en passant, castling, promotion and their prerequisites. It ends in a draw on fivefold repetition, after seventy-five moves without a capture or pawn move, and when neither side has the material left to checkmate. After threefold repetition, or fifty such moves, either player can type "draw" to claim one.
 
+Type "undo" to take back the last move and "redo" to play it again, or "ply=N" to go to the position after the first N moves (ply=0 is the start).
 
-August 2021 by Dion Adam
-*/
+With book=<file.bin> on the command line, "book" suggests a move from that Polyglot opening book and lists every book move of the position with its share, and "book=<move>" tells whether a move is in the book, without playing it.
 
+Type "eval" to see how the computer judges the position, in pawns for White: material and where the pieces stand, their mobility, the pawn structure and the safety of the kings.
 
-#include <iostream>
-#include <utility> 
-#include <vector>
-#include <algorithm>
+With nnue=<file> on the command line, the computer judges positions with that neural network instead, and "eval" shows its verdict too.
 
-using namespace std;
+Type "hint" to get a suggested move, or "go" to let the computer play the move for the side to play, e.g. to spar against it. It thinks for about a second.
 
-#define pci pair<char, int>
-#define file position.first
-#define rank position.second
-#define def "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq -"
+On a machine with many cores, "threads=N" (typed during the game, or given on the command line) lets the computer think with N threads. "chess analyse <milliseconds> [fen]" searches one position for that long and prints the result.
 
-enum Color{white, black};
+Move generation can be checked and timed with "chess perft <depth> [fen]", which counts the positions reachable in <depth> moves, or with "chess divide <depth> [fen]", which also lists the count below each first move.
 
-class Piece;
-class chessboard;
-void move(pci initial_position, pci position, chessboard& B);
+"chess tablebase <dir> [pieces]" solves every endgame of up to four pieces (or pieces, if fewer), kings included, into files in dir, on every core unless threads=N is given. With tablebases=<dir> on the command line, "tb" tells who mates in how many moves, or that it is a draw, and "hint" and "go" play the best move straight from the tables.
 
-class chessboard{
-public:
-    chessboard();
-    chessboard(chessboard &b);
-    ~chessboard();
-    Piece*& access(pci position);
-    void setup(const string &s=def);
-    friend ostream& operator << (ostream& out, chessboard& b); 
-    class Player{
-    public:
-        Player() {}
-        pci king;
-        pair<pci, pci> lastmove={{' ', 0}, {' ', 0}};
-        bool shortcastleright=false;
-        bool longcastleright=false;
-    };
-    Player white_player;
-    Player black_player;
+"chess --script <session> [times]" plays a recorded session, a file of the same commands a player would type, game after game without printing the boards, and reports the time taken per move. It runs the session the given number of times, as a load test.
 
-    Player& returnPlayer(Color c){
-        if(c==white)
-            return white_player;
-        else
-            return black_player;
-    }
-    void play();
-    Color to_play;
+"chess serve <port|socket path> [threads=N]" hosts many games at once in one process, one per connection on a local TCP port or a Unix socket, with N worker threads (every core by default). A client sends the same commands a player would type, one or more per line; the games search with one thread each.
 
-private:
-    Piece* square[8][8];
-};
+"chess replay <file.pgn> [threads=N]" checks a PGN archive ("-" reads standard input): every game is replayed move by move, and a line per game says whether its starting position and all its moves were legal and whether the final position agrees with the stated result. It uses every core unless threads=N is given.
 
-chessboard:: chessboard(){
-    for(int i=0; i<8; i++)
-            for(int j=0; j<8; j++) square[i][j]=nullptr;
-}
 
-Piece*& chessboard:: access(pci position){
-    if(file < 'a' || file>'h' || rank<1 || rank>8)
-        throw out_of_range("invalid index");
-    return square[file-'a'][rank-1]; 
-}
+August 2021 by Dion Adam
+*/
 
-/////////////////////////////////////////////////////////
 
-class Piece{
-public:
-    Piece(pci initial_position, Color c): position(initial_position), c(c) {}
-    pci position;
-    Color c;
-    char label;
-    vector<pci> moves;
-    vector<pci> checked_moves;
-    virtual void moveable_to(chessboard &b)=0;
-    bool is_in_danger(chessboard &b){
-          for(char i='a'; i<='h'; i++)
-            for(int j=1; j<=8; j++){
-                bool g=false;
-                Piece* x=b.access({i, j});
-                if(x!=nullptr && x->c!=c){
-                    x->moveable_to(b);
-                    if(find(x->moves.begin(), x->moves.end(), position)!=x->moves.end())
-                        g=true;
-                    x->moves.clear();
-                }
-                if(g) return true;
-            }
-        return false;
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include "board.h"
+#include "book.h"
+#include "history.h"
+#include "nnue.h"
+#include "perft.h"
+#include "pgn.h"
+#include "search.h"
+#include "server.h"
+#include "tablebase.h"
+
+// Time budget and threads of "hint" and "go", and the hash table they share.
+search_limits think_limits={max_ply-1, 0, 1000, 1};
+static transposition_table hash_table(16);
+static game_history history;
+static bool threads_given=false;
+
+// The opening book given with book=<file.bin>, shared by every game.
+static unique_ptr<opening_book> book;
+
+// The network given with nnue=<file>.
+static nnue_network network;
+
+// The endgame tables given with tablebases=<dir>.
+static unique_ptr<tablebase> tablebases;
+
+// The computer's move: from the tables when the position is in them,
+// else searched.
+static Move think(chessboard& B, const search_limits& limits){
+    Move m=(tablebases ? tablebases->best_move(B) : Move());
+    if(m==Move())
+        m=search(B, limits, hash_table).best;
+    return m;
+}
+
+// Time taken by each command that played a move, from reading it to the
+// check for the end of the game.
+static struct{
+    unsigned long long moves=0;
+    double seconds=0;
+    double slowest=0;
+} move_times;
+
+// Carries out one command or move of the game and writes the replies to
+// out. Returns true once the game is over. Without render the board is
+// not printed.
+bool chessboard:: command(string s, ostream& out, bool render, game_history& history, search_limits& limits){
+    string s1, s2;
+    if(to_play==white){
+        s1="White";
+        s2="Black";
     }
-    void checkmoves(chessboard &b){
-        for(int i=0; i<moves.size(); i++){
-            chessboard b1(b);
-            move(position, moves[i], b1);
-            if(!b1.access(b1.returnPlayer(c).king)->is_in_danger(b1))
-                checked_moves.push_back(moves[i]);
-        }
+    else{
+        s1="Black";
+        s2="White";
     }
-};
-
-class Pawn: public Piece {
-public:
-    Pawn(pci initial_position, Color c): Piece(initial_position, c){label='p';}
-    void moveable_to(chessboard &b) override {
-        if(c==white){
-            if(b.access({file, rank+1})==nullptr){    
-                moves.push_back({file, rank+1});
-                if(rank==2 && b.access({file, rank+2})==nullptr)
-                    moves.push_back({file, rank+2});    
-            }
-            try{
-                Piece* capture1=b.access({file+1, rank+1});
-                if(capture1!=nullptr && capture1->c==black)
-                    moves.push_back({file+1, rank+1});
-            } catch(out_of_range){}
-            try{
-                Piece* capture2=b.access({file-1, rank+1});
-                if(capture2!=nullptr && capture2->c==black)
-                    moves.push_back({file-1, rank+1});
-            } catch(out_of_range){}
-
-            if(rank==5){
-                try{
-                Piece* capture1=b.access({file+1, 5});
-                pci pos1={file+1, 7};
-                pci pos2={file+1, 5};
-                if(capture1!=nullptr && capture1->label=='p' && capture1->c==black && b.black_player.lastmove==make_pair(pos1, pos2))
-                    moves.push_back({file+1, 6});
-                } catch(out_of_range){}
-                try{
-                Piece* capture2=b.access({file-1, 5});
-                pci pos1={file-1, 7};
-                pci pos2={file-1, 5};
-                if(capture2!=nullptr && capture2->label=='p' && capture2->c==black && b.black_player.lastmove==make_pair(pos1, pos2))
-                    moves.push_back({file-1, 6});
-                } catch(out_of_range){}
-            }
+    if(s=="resign"){
+        out << s1 << " resigned, "<< s2 << " wins!\n";
+        return true;
+    }
+    if(s=="draw"){
+        if(history.repetitions(*this)>=3){
+            out << "Threefold repetition, Draw!\n";
+            return true;
         }
-        else{
-            if(b.access({file, rank-1})==nullptr){
-                moves.push_back({file, rank-1});
-                if(rank==7 && b.access({file, rank-2})==nullptr)
-                    moves.push_back({file, rank-2});  
-            }
-            try{
-                Piece* capture1=b.access({file+1, rank-1});
-                if(capture1!=nullptr && capture1->c==white)
-                    moves.push_back({file+1, rank-1});
-            } catch(out_of_range){}
-
-            try{
-                Piece* capture2=b.access({file-1, rank-1});
-                if(capture2!=nullptr && capture2->c==white)
-                    moves.push_back({file-1, rank-1});
-            } catch(out_of_range){}
-            if(rank==4){
-                try{
-                Piece* capture1=b.access({file+1, 4});
-                pci pos1={file+1, 2};
-                pci pos2={file+1, 4};
-                if(capture1!=nullptr && capture1->label=='p' && capture1->c==white && b.white_player.lastmove==make_pair(pos1, pos2))
-                    moves.push_back({file+1, 3});
-                } catch(out_of_range){}
-                try{
-                Piece* capture2=b.access({file-1, 4});
-                pci pos1={file-1, 2};
-                pci pos2={file-1, 4};
-                if(capture2!=nullptr && capture2->label=='p' && capture2->c==white && b.white_player.lastmove==make_pair(pos1, pos2))
-                    moves.push_back({file-1, 3});
-                } catch(out_of_range){}
-            }
+        if(check_state(*this, &history.legal)!=2){
+            out << "no draw to claim\n";
+            return false;
         }
+        out << "Fifty moves without a capture or pawn move, Draw!\n";
+        return true;
     }
-};
-
-class Rook: public Piece{
-public:
-    Rook(pci initial_position, Color c): Piece(initial_position, c){label='R';}
-    void moveable_to(chessboard &b) override {
-        char col=file;
-        int row=rank;
-        try{
-            while(1){
-                row++;
-                Piece* x=b.access({col, row});
-                if(x==nullptr)
-                    moves.push_back({col, row});
-                else{
-                    if(x->c!=c)
-                        moves.push_back({col, row});
-                    break;
-                }
-            } 
-        }catch(out_of_range){}
-        col=file;
-        row=rank;
-        try{
-            while(1){
-                col++;
-                Piece* x=b.access({col, row});
-                if(x==nullptr)
-                    moves.push_back({col, row});
-                else{
-                    if(x->c!=c)
-                        moves.push_back({col, row});
-                    break;
-                }
-            } 
-        }catch(out_of_range){}
-        col=file;
-        row=rank;
-        try{
-            while(1){
-                row--;
-                Piece* x=b.access({col, row});
-                if(x==nullptr)
-                    moves.push_back({col, row});
-                else{
-                    if(x->c!=c)
-                        moves.push_back({col, row});
-                    break;
-                }
-            } 
-        }catch(out_of_range){}
-        col=file;
-        row=rank;
-        try{
-            while(1){
-                col--;
-                Piece* x=b.access({col, row});
-                if(x==nullptr)
-                    moves.push_back({col, row});
-                else{
-                    if(x->c!=c)
-                        moves.push_back({col, row});
-                    break;
-                }
-            } 
-        }catch(out_of_range){}
-    }
-};
-
-class Bishop: public Piece{
-public:
-    Bishop(pci initial_position, Color c): Piece(initial_position, c){label='B';}
-    void moveable_to(chessboard &b) override {
-        char col=file;
-        int row=rank;
-        try{
-            while(1){
-                row++;
-                col++;
-                Piece* x=b.access({col, row});
-                if(x==nullptr)
-                    moves.push_back({col, row});
-                else{
-                    if(x->c!=c)
-                        moves.push_back({col, row});
-                    break;
-                }
-            } 
-        }catch(out_of_range){}
-        col=file;
-        row=rank;
-        try{
-            while(1){
-                row++;
-                col--;
-                Piece* x=b.access({col, row});
-                if(x==nullptr)
-                    moves.push_back({col, row});
-                else{
-                    if(x->c!=c)
-                        moves.push_back({col, row});
-                    break;
-                }
-            } 
-        }catch(out_of_range){}
-        col=file;
-        row=rank;
-        try{
-            while(1){
-                row--;
-                col++;
-                Piece* x=b.access({col, row});
-                if(x==nullptr)
-                    moves.push_back({col, row});
-                else{
-                    if(x->c!=c)
-                        moves.push_back({col, row});
-                    break;
-                }
-            } 
-        }catch(out_of_range){}
-        col=file;
-        row=rank;
-        try{
-            while(1){
-                row--;
-                col--;
-                Piece* x=b.access({col, row});
-                if(x==nullptr)
-                    moves.push_back({col, row});
-                else{
-                    if(x->c!=c)
-                        moves.push_back({col, row});
-                    break;
-                }
-            } 
-        }catch(out_of_range){}
-    }
-};
-
-class Knight:public Piece{
-public:
-    Knight(pci initial_position, Color c): Piece(initial_position, c){label='N';}
-    void moveable_to(chessboard &b) override {
-        char col;
-        int row;
-        try{
-            col=file+2;
-            row=rank+1;
-            Piece* x=b.access({col, row});
-            if(x==nullptr || x->c!=c)
-                moves.push_back({col, row});
-        }catch(out_of_range){}
-        try{
-            col=file+1;
-            row=rank+2;
-            Piece* x=b.access({col, row});
-            if(x==nullptr || x->c!=c)
-                moves.push_back({col, row});
-        }catch(out_of_range){}
-        try{
-            col=file-2;
-            row=rank+1;
-            Piece* x=b.access({col, row});
-            if(x==nullptr || x->c!=c)
-                moves.push_back({col, row});
-        }catch(out_of_range){}
-        try{
-            col=file+1;
-            row=rank-2;
-            Piece* x=b.access({col, row});
-            if(x==nullptr || x->c!=c)
-                moves.push_back({col, row});
-        }catch(out_of_range){}
-        try{
-            col=file+2;
-            row=rank-1;
-            Piece* x=b.access({col, row});
-            if(x==nullptr || x->c!=c)
-                moves.push_back({col, row});
-        }catch(out_of_range){}
-        try{
-            col=file-1;
-            row=rank+2;
-            Piece* x=b.access({col, row});
-            if(x==nullptr || x->c!=c)
-                moves.push_back({col, row});
-        }catch(out_of_range){}
-        try{
-            col=file-2;
-            row=rank-1;
-            Piece* x=b.access({col, row});
-            if(x==nullptr || x->c!=c)
-                moves.push_back({col, row});
-        }catch(out_of_range){}
-        try{
-            col=file-1;
-            row=rank-2;
-            Piece* x=b.access({col, row});
-            if(x==nullptr || x->c!=c)
-                moves.push_back({col, row});
-        }catch(out_of_range){}
+    if(s.compare(0, 8, "threads=")==0){
+        limits.threads=max(1, atoi(s.c_str()+8));
+        if(limits.max_threads)
+            limits.threads=min(limits.threads, limits.max_threads);
+        return false;
     }
-};
-
-class Queen:public Piece{
-public:
-    Queen(pci initial_position, Color c): Piece(initial_position, c){label='Q';}
-    void moveable_to(chessboard &b) override {
-        char col=file;
-        int row=rank;
-        try{
-            while(1){
-                row++;
-                Piece* x=b.access({col, row});
-                if(x==nullptr)
-                    moves.push_back({col, row});
-                else{
-                    if(x->c!=c)
-                        moves.push_back({col, row});
-                    break;
-                }
-            } 
-        }catch(out_of_range){}
-        col=file;
-        row=rank;
-        try{
-            while(1){
-                col++;
-                Piece* x=b.access({col, row});
-                if(x==nullptr)
-                    moves.push_back({col, row});
-                else{
-                    if(x->c!=c)
-                        moves.push_back({col, row});
-                    break;
-                }
-            } 
-        }catch(out_of_range){}
-        col=file;
-        row=rank;
-        try{
-            while(1){
-                row--;
-                Piece* x=b.access({col, row});
-                if(x==nullptr)
-                    moves.push_back({col, row});
-                else{
-                    if(x->c!=c)
-                        moves.push_back({col, row});
-                    break;
-                }
-            } 
-        }catch(out_of_range){}
-        col=file;
-        row=rank;
-        try{
-            while(1){
-                col--;
-                Piece* x=b.access({col, row});
-                if(x==nullptr)
-                    moves.push_back({col, row});
-                else{
-                    if(x->c!=c)
-                        moves.push_back({col, row});
-                    break;
-                }
-            } 
-        }catch(out_of_range){}
-        col=file;
-        row=rank;
-        try{
-            while(1){
-                row++;
-                col++;
-                Piece* x=b.access({col, row});
-                if(x==nullptr)
-                    moves.push_back({col, row});
-                else{
-                    if(x->c!=c)
-                        moves.push_back({col, row});
-                    break;
-                }
-            } 
-        }catch(out_of_range){}
-        col=file;
-        row=rank;
-        try{
-            while(1){
-                row++;
-                col--;
-                Piece* x=b.access({col, row});
-                if(x==nullptr)
-                    moves.push_back({col, row});
-                else{
-                    if(x->c!=c)
-                        moves.push_back({col, row});
-                    break;
-                }
-            } 
-        }catch(out_of_range){}
-        col=file;
-        row=rank;
-        try{
-            while(1){
-                row--;
-                col++;
-                Piece* x=b.access({col, row});
-                if(x==nullptr)
-                    moves.push_back({col, row});
-                else{
-                    if(x->c!=c)
-                        moves.push_back({col, row});
-                    break;
-                }
-            } 
-        }catch(out_of_range){}
-        col=file;
-        row=rank;
-        try{
-            while(1){
-                row--;
-                col--;
-                Piece* x=b.access({col, row});
-                if(x==nullptr)
-                    moves.push_back({col, row});
-                else{
-                    if(x->c!=c)
-                        moves.push_back({col, row});
-                    break;
-                }
-            } 
-        }catch(out_of_range){}
+    if(s=="undo" || s=="redo" || s.compare(0, 4, "ply=")==0){
+        bool g;
+        if(s=="undo")
+            g=history.undo(*this);
+        else if(s=="redo")
+            g=history.redo(*this);
+        else
+            g=history.go_to(*this, atoi(s.c_str()+4));
+        if(!g)
+            out << "no such move\n";
+        else if(render)
+            out << *this << "\n";
+        return false;
     }
-};
-
-class King:public Piece{
-    public:
-    King(pci initial_position, Color c): Piece(initial_position, c){label='K';}
-    void moveable_to(chessboard &b) override {
-        char col;
-        int row;
-        try{
-            col=file;
-            row=rank+1;
-            Piece* x=b.access({col, row});
-            if(x==nullptr || x->c!=c)
-                moves.push_back({col, row});
-        }catch(out_of_range){}
-        try{
-            col=file+1;
-            row=rank;
-            Piece* x=b.access({col, row});
-            if(x==nullptr || x->c!=c)
-                moves.push_back({col, row});
-        }catch(out_of_range){}
-        try{
-            col=file;
-            row=rank-1;
-            Piece* x=b.access({col, row});
-            if(x==nullptr || x->c!=c)
-                moves.push_back({col, row});
-        }catch(out_of_range){}
-        try{
-            col=file-1;
-            row=rank;
-            Piece* x=b.access({col, row});
-            if(x==nullptr || x->c!=c)
-                moves.push_back({col, row});
-        }catch(out_of_range){}
-        try{
-            col=file+1;
-            row=rank+1;
-            Piece* x=b.access({col, row});
-            if(x==nullptr || x->c!=c)
-                moves.push_back({col, row});
-        }catch(out_of_range){}
-        try{
-            col=file-1;
-            row=rank+1;
-            Piece* x=b.access({col, row});
-            if(x==nullptr || x->c!=c)
-                moves.push_back({col, row});
-        }catch(out_of_range){}
-        try{
-            col=file+1;
-            row=rank-1;
-            Piece* x=b.access({col, row});
-            if(x==nullptr || x->c!=c)
-                moves.push_back({col, row});
-        }catch(out_of_range){}
-        try{
-            col=file-1;
-            row=rank-1;
-            Piece* x=b.access({col, row});
-            if(x==nullptr || x->c!=c)
-                moves.push_back({col, row});
-        }catch(out_of_range){}
+    if(s=="hint"){
+        out << "hint: " << move_to_san(*this, think(*this, limits), &history.legal) << "\n";
+        return false;
     }
-};
-
-//////////////////////////////////////////////////////////////////////////
-
-chessboard:: ~chessboard(){   
-    for(int i=0; i<8; i++)
-        for(int j=0; j<8; j++)
-            delete square[i][j];
-}
-
-chessboard:: chessboard(chessboard& b){
-    for(int i=0; i<8; i++)
-            for(int j=0; j<8; j++){
-                Piece* x=b.square[i][j];
-                if(x!=nullptr){
-                    if(x->label=='p')
-                        square[i][j]=new Pawn({'a'+i, 1+j}, x->c);
-                    else if(x->label=='R')
-                        square[i][j]=new Rook({'a'+i, 1+j}, x->c);
-                    else if(x->label=='B')
-                        square[i][j]=new Bishop({'a'+i, 1+j}, x->c);
-                    else if(x->label=='N')
-                        square[i][j]=new Knight({'a'+i, 1+j}, x->c);
-                    else if(x->label=='Q')
-                        square[i][j]=new Queen({'a'+i, 1+j}, x->c);
-                    else
-                        square[i][j]=new King({'a'+i, 1+j}, x->c);
-                }
-                else
-                    square[i][j]=nullptr;
-            }
-    white_player=b.white_player;
-    black_player=b.black_player;
-    to_play=b.to_play;
-
-}
-
-ostream& operator << (ostream& out, chessboard& b){
-    for(unsigned i=8; i>=1; i--){   
-        for(char j='a'; j<='h'; j++){
-            char y;
-            Piece* p=b.access({j, i});
-            if(p!=nullptr)
-                y=p->label;
+    if(s=="book" || s.compare(0, 5, "book=")==0){
+        vector<book_move> moves;
+        if(book)
+            book->probe(*this, moves);
+        if(!book)
+            out << "no opening book\n";
+        else if(moves.empty())
+            out << "out of book\n";
+        else if(s=="book"){
+            long total=0;
+            for(const book_move& m : moves)
+                total+=m.weight;
+            out << "book: " << move_to_san(*this, book->pick(*this), &history.legal) << " (";
+            for(size_t i=0; i<moves.size(); i++)
+                out << (i ? ", " : "") << move_to_san(*this, moves[i].move, &history.legal) << " " << (total ? moves[i].weight*100/total : 0) << "%";
+            out << ")\n";
+        }
+        else{
+            Move m;
+            if(read_san(s.substr(5), *this, m, &history.legal)!=san_ok)
+                out << "invalid move\n";
+            else if(find_if(moves.begin(), moves.end(), [m](const book_move& b){return b.move==m;})==moves.end())
+                out << s.substr(5) << " is not a book move\n";
             else
-                y=' ';
-            out << "|";
-            out << y;
+                out << s.substr(5) << " is a book move\n";
         }
-        out << "|" << endl;
+        return false;
     }
-    return out;
-}
-
-///////////////////////////////////////////////////////////////////////////////////////////////
-
-void move(pci initial_position, pci position, chessboard& B){
-    Piece* tmp=B.access(position);
-    Piece* x=B.access(initial_position);
-    if(x->label=='p' && initial_position.first!=file && tmp==nullptr){
-        Piece* y=B.access({file, initial_position.second});
-        delete y;
-        B.access({file, initial_position.second})=nullptr;
+    if(s=="eval"){
+        eval_terms e=evaluate_terms(*this);
+        auto pawns=[](int cp){
+            ostringstream o;
+            o << showpos << fixed << setprecision(2) << cp/100.0;
+            return o.str();
+        };
+        out << "eval: " << pawns(e.total) << " for White\n"
+            << "  material and squares " << pawns(e.material) << "\n"
+            << "  mobility             " << pawns(e.mobility) << "\n"
+            << "  pawn structure       " << pawns(e.pawns) << "\n"
+            << "  king safety          " << pawns(e.king_safety) << "\n"
+            << "  phase " << e.phase << "/" << max_phase << (e.phase>max_phase/2 ? " (middlegame)" : " (endgame)") << "\n";
+        if(nnue_net){
+            int n=nnue_evaluate(*this);
+            out << "  network              " << pawns(to_play==white ? n : -n) << "\n";
+        }
+        return false;
+    }
+    if(s=="tb"){
+        tb_result r;
+        if(tablebases)
+            r=tablebases->probe(*this);
+        if(!r.found)
+            out << "not in the tablebases\n";
+        else if(r.wdl==0)
+            out << "Draw with best play\n";
+        else
+            out << (r.wdl>0 ? s1 : s2) << " mates in " << (r.plies+1)/2 << "\n";
+        return false;
     }
-    delete tmp;
-    B.access(position)=B.access(initial_position);
-    B.access(initial_position)=nullptr;
-    x->position=position;
-        B.returnPlayer(x->c).lastmove={initial_position, position};
-        if(x->label=='K'){
-            B.returnPlayer(x->c).king=position;
-            B.returnPlayer(x->c).shortcastleright=false;
-            B.returnPlayer(x->c).longcastleright=false;
+    if(s=="go"){
+        s=move_to_san(*this, think(*this, limits), &history.legal);
+        out << s << "\n";
+    }
+    Move m;
+    san_error e=read_san(s, *this, m, &history.legal);
+    if(e==san_ok){
+        history.play(*this, m);
+        if(render)
+            out << *this << "\n";
+        int x=check_state(*this, &history.legal);
+        if(x==1){
+            out << "Checkmate, " << s1 << " wins!\n";
+            return true;
         }
-        else if(x->label=='R'){
-            pci pos1={'h', 1};
-            pci pos2={'a', 1};
-            if(initial_position==pos1)
-                B.returnPlayer(x->c).shortcastleright=false;
-            else if(initial_position==pos2)
-                B.returnPlayer(x->c).longcastleright=false;
+        else if(x==-1){
+            out << "Stalemate, Draw!\n";
+            return true;
         }
-}
-
-bool find_piece(pci position, chessboard& B, char label){
-    bool g=false;
-    pci initial_position;
-    Color c=B.to_play;
-    for(char i='a'; i<='h'; i++)
-        for(int j=1; j<=8; j++){
-            Piece* x=B.access({i, j});
-            if(x!=nullptr && x->label==label && x->c==c){
-                x->moveable_to(B);
-                x->checkmoves(B);
-                if(find(x->checked_moves.begin(), x->checked_moves.end(), position)!=x->checked_moves.end()){
-                    initial_position={i, j};
-                    if(!g)
-                        g=true;
-                    else
-                        return false;
-                }
-                x->moves.clear(); 
-                x->checked_moves.clear();
-            }  
+        else if(x==-2){
+            out << "Seventy-five moves without a capture or pawn move, Draw!\n";
+            return true;
         }
-    if(g)
-        move(initial_position, position, B);
-    return g;    
-}
-
-bool find_specific_col_piece(char col, pci position, chessboard& B, char label){
-    bool g=false, e=false;
-    pci initial_position;
-    Color c=B.to_play;
-    for(char i='a'; i<='h'; i++)
-        for(int j=1; j<=8; j++){
-            Piece* x=B.access({i, j});
-            if(x!=nullptr && x->label==label && x->c==c){
-                x->moveable_to(B);
-                x->checkmoves(B);
-                if(find(x->checked_moves.begin(), x->checked_moves.end(), position)!=x->checked_moves.end()){
-                    if(x->file==col){    
-                        if(label=='p'){
-                            x->moves.clear(); 
-                            x->checked_moves.clear();
-                            move({i, j}, position, B);
-                            return true;
-                        }
-                        else if(!e){
-                            initial_position={i, j};
-                            e=true;
-                        }
-                        else{
-                            x->moves.clear(); 
-                            x->checked_moves.clear();
-                            return false;
-                        }
-                    }
-                    else
-                        g=true;
-
-                }            
-                x->moves.clear(); 
-                x->checked_moves.clear();
-            }  
+        else if(x==-3){
+            out << "Not enough material to checkmate, Draw!\n";
+            return true;
         }
-    if(e==true && g==true){
-        move(initial_position, position, B);
-        return true;
+        int repeated=history.repetitions(*this);
+        if(repeated>=5){
+            out << "Fivefold repetition, Draw!\n";
+            return true;
+        }
+        if(repeated>=3)
+            out << "Threefold repetition, type \"draw\" to claim a draw\n";
+        if(x==2 && halfmove_clock==100)
+            out << "Fifty moves without a capture or pawn move, type \"draw\" to claim a draw\n";
     }
-    else 
-        return false; 
+    else if(e==san_ambiguous)
+        out << "ambiguous move, give the file or rank of the piece\n";
+    else
+        out << "invalid move\n";
+    return false;
 }
 
-bool find_specific_row_piece(int row, pci position, chessboard& B, char label){
-    bool g=false, e=false;
-    pci initial_position;
-    Color c=B.to_play;
-    for(char i='a'; i<='h'; i++)
-        for(int j=1; j<=8; j++){
-            Piece* x=B.access({i, j});
-            if(x!=nullptr && x->label==label && x->c==c){
-                x->moveable_to(B);
-                x->checkmoves(B);
-                if(find(x->checked_moves.begin(), x->checked_moves.end(), position)!=x->checked_moves.end()){
-                    if(x->rank==row){
-                        if(!e){
-                            initial_position={i, j};
-                            e=true;
-                        }
-                        else
-                            return false;
-                    }
-                    else if(x->file==i)
-                        g=true;
-                }            
-                x->moves.clear(); 
-                x->checked_moves.clear();
-            }  
+// Plays one game from the commands in in. Returns true when the game
+// ended, false when the input did first. Every command that plays a move
+// is timed.
+bool chessboard:: play(istream& in, ostream& out, bool render, game_history& history, search_limits& limits){
+    string s;
+    while(true){
+        if(render)
+            out << "> ";
+        if(!(in >> s))
+            return false;
+        auto start=chrono::steady_clock::now();
+        int ply=history.ply();
+        bool over=command(s, out, render, history, limits);
+        if(history.ply()>ply){
+            double seconds=chrono::duration<double>(chrono::steady_clock::now()-start).count();
+            move_times.moves++;
+            move_times.seconds+=seconds;
+            move_times.slowest=max(move_times.slowest, seconds);
         }
-    if(g==true && e==true){
-        move(initial_position, position, B);
-        return true;
+        if(over)
+            return true;
     }
-    else 
-        return false;
 }
 
-void promote(pci position, char label, Color c, chessboard& b){
-    delete b.access(position);
-    if(label=='R')
-        b.access(position)=new Rook(position, c);
-    else if(label=='B')
-         b.access(position)=new Bishop(position, c);
-    else if(label=='N')
-        b.access(position)=new Knight(position, c);
-    else
-         b.access(position)=new Queen(position, c);
+// The FEN may come as one argument or as its six fields.
+string fen_argument(const vector<string>& args, size_t first){
+    if(args.size()<=first)
+        return def;
+    string fen=args[first];
+    for(size_t i=first+1; i<args.size(); i++)
+        fen=fen+" "+args[i];
+    return fen;
 }
 
-bool understand_move(string &s, chessboard &B){
-    pci position;
-    char col, label;
-    Color c=B.to_play;
-    int row, num;
-    if(c==white)
-        num=1;
-    else
-        num=8;
-    if(s[0]>='a' && s[0]<='h'){     
-        if(s[1]=='x'){
-            col=s[0];
-            file=s[2];
-            rank=s[3]-'0';
-            try{Piece* x=B.access(position);}catch(out_of_range){return false;}
-            if((c==white && rank<8 || c==black && rank>1) && s.size()==4){
-                if(find_specific_col_piece(col,position, B, 'p'))
-                    return true;
-            }
-            else{
-                label=s[5];
-                if(s[4]=='=' && (label=='R' || label=='B' || label=='Q' || label=='N') && s.size()==6){    
-                    if(find_specific_col_piece(col,position, B, 'p')){
-                        promote(position, label, c, B);
-                        return true;
-                    }
-                }
-            }
-        }
-        else{
-            file=s[0];
-            rank=s[1]-'0'; 
-            try{Piece* x=B.access(position);}catch(out_of_range){return false;}   
-            if((c==white && rank<8 || c==black && rank>1) && s.size()==2){
-                if(find_piece(position, B, 'p'))
-                    return true;
-            }
-            else{
-                label=s[3];
-                if(s[2]=='=' && (label=='R' || label=='B' || label=='Q' || label=='N') && s.size()==4){
-                    if(find_piece(position, B, 'p')){
-                        promote(position, label, c, B);
-                        return true;
-                    }
-                }
-            }
-        }
+int perft_mode(const vector<string>& args){
+    int depth=atoi(args[1].c_str());
+    chessboard B;
+    if(!B.setup(fen_argument(args, 2))){
+        cout << "invalid FEN: " << fen_argument(args, 2) << endl;
+        return 1;
     }
-    else if(s=="O-O"){
-        Piece* x=B.access({'e', num});
-        if(B.returnPlayer(c).shortcastleright==true && x->is_in_danger(B)==false)
-            if(B.access({'f', num})==nullptr && B.access({'g', num})==nullptr)
-            {
-                chessboard B1(B);
-                move({'e', num}, {'g', num}, B1);
-                move({'h', num}, {'f', num}, B1);
-                if(B1.access({'f', num})->is_in_danger(B1)==false && B1.access({'g', num})->is_in_danger(B1)==false){
-                    move({'e', num}, {'g', num}, B);
-                    move({'h', num}, {'f', num}, B);
-                    return true;
-                }
-            }
+    auto start=chrono::steady_clock::now();
+    unsigned long long nodes;
+    if(args[0]=="divide"){
+        nodes=divide(B, depth, cout);
+        cout << endl;
     }
-    else if(s=="O-O-O"){
-        Piece* x=B.access({'e', num});
-        if(B.returnPlayer(c).longcastleright==true && x->is_in_danger(B)==false)
-            if(B.access({'d', num})==nullptr && B.access({'c', num})==nullptr && B.access({'b', num})==nullptr)
-            {
-                chessboard B1(B);
-                move({'e', num}, {'c', num}, B1);
-                move({'a', num}, {'d', num}, B1);
-                if(B1.access({'c', num})->is_in_danger(B1)==false && B1.access({'d', num})->is_in_danger(B1)==false){
-                    move({'e', num}, {'c', num}, B);
-                    move({'a', num}, {'d', num}, B);
-                    return true;
-                }
-            }
+    else
+        nodes=perft(B, depth);
+    double seconds=chrono::duration<double>(chrono::steady_clock::now()-start).count();
+    cout << "Nodes: " << nodes << endl;
+    cout << "Time: " << seconds << " s" << endl;
+    if(seconds>0)
+        cout << "Nodes/second: " << (unsigned long long)(nodes/seconds) << endl;
+    return 0;
+}
+
+int analyse_mode(const vector<string>& args){
+    search_limits limits=think_limits;
+    limits.milliseconds=atoi(args[1].c_str());
+    chessboard B;
+    if(!B.setup(fen_argument(args, 2))){
+        cout << "invalid FEN: " << fen_argument(args, 2) << endl;
+        return 1;
     }
-    else if(s.size()>=3){
-        label=s[0];
-        if(label!='p'){
-            file=s[s.size()-2];
-            rank=s[s.size()-1]-'0';
-            try{
-                Piece* x=B.access(position);
-                if(s.size()==3 && x==nullptr){
-                    if(find_piece(position, B, label))
-                        return true;
-                }
-                else if(s.size()==4 && s[1]=='x' && x!=nullptr){
-                    if(find_piece(position, B, label))
-                        return true;
-                }
-                else if(s[1]>='a' && s[1]<='h' && s.size()==4 && x==nullptr){
-                    col=s[1];
-                    if(find_specific_col_piece(col,position, B, label))
-                        return true;
-                }
-                else if(s[1]>='a' && s[1]<='h' && s[2]=='x' && s.size()==5 && x!=nullptr){
-                    col=s[1];
-                    if(find_specific_col_piece(col,position, B, label))
-                        return true;
-                }
-                else if(s[1]>='1' && s[1]<='8' && s.size()==4 && x==nullptr){
-                    row=s[1]-'0';
-                    if(find_specific_row_piece(row, position, B, label))
-                        return true;
-                }
-                else if(s[1]>='1' && s[1]<='8' && s[2]=='x' && s.size()==5 && x!=nullptr){
-                    row=s[1]-'0';
-                    if(find_specific_row_piece(row ,position, B, label))
-                        return true;
-                }
-            } catch(out_of_range){return false;}
-        }
+    auto start=chrono::steady_clock::now();
+    search_result r=search(B, limits, hash_table);
+    double seconds=chrono::duration<double>(chrono::steady_clock::now()-start).count();
+    if(r.best==Move()){
+        cout << "No legal moves" << endl;
+        return 0;
     }
-    return false;
+    cout << "Best move: " << move_to_san(B, r.best) << endl;
+    cout << "Score: " << r.score << endl;
+    cout << "Depth: " << r.depth << endl;
+    cout << "Nodes: " << r.nodes << endl;
+    if(seconds>0)
+        cout << "Nodes/second: " << (unsigned long long)(r.nodes/seconds) << endl;
+    for(size_t i=0; i<r.thread_nodes.size(); i++)
+        cout << "Thread " << i << ": " << r.thread_nodes[i] << " nodes" << endl;
+    return 0;
 }
 
-int check_state(chessboard& B){
-    bool g=true;
-    Color c=B.to_play;
-    for(char i='a'; i<='h'; i++)
-        for(int j=1; j<=8; j++){
-            Piece* x=B.access({i, j});
-            if(x!=nullptr && x->c==c){
-                x->moveable_to(B);
-                x->checkmoves(B);
-                if(!x->checked_moves.empty())
-                    g=false;
-                x->moves.clear(); 
-                x->checked_moves.clear();
-            }
-        }
-        if(g)
-        {   if(B.access(B.returnPlayer(c).king)->is_in_danger(B))
-                return 1;
-            else
-                return -1;
+int replay_mode(const vector<string>& args){
+    int threads=(threads_given ? think_limits.threads : max(1u, thread::hardware_concurrency()));
+    auto start=chrono::steady_clock::now();
+    replay_summary r;
+    if(args[1]=="-")
+        r=replay_pgn(cin, cout, threads);
+    else{
+        mapped_file file(args[1]);
+        if(!file.is_open()){
+            cout << "cannot open " << args[1] << endl;
+            return 1;
         }
-        else
-            return 0;
+        r=replay_pgn(file.view(), cout, threads);
+    }
+    double seconds=chrono::duration<double>(chrono::steady_clock::now()-start).count();
+    cout << "Games: " << r.games << ", illegal: " << r.illegal << ", result mismatches: " << r.mismatches << endl;
+    cout << "Plies: " << r.plies << endl;
+    cout << "Time: " << seconds << " s" << endl;
+    if(seconds>0)
+        cout << "Games/second: " << (unsigned long long)(r.games/seconds) << endl;
+    return (r.illegal || r.mismatches) ? 2 : 0;
 }
 
-void chessboard:: play(){
-    string s, s1, s2;
-    if(to_play==white){
-        s1="White";
-        s2="Black";
-    }
-    else{
-        s1="Black";
-        s2="White";
-    }
-    cout << "> ";
-    cin >> s;
-    if(s=="resign"){
-        cout << s1 << " resigned, "<< s2 << " wins!" << endl;
-        return;
+// Replays a recorded session, one game after another until the input
+// ends, with the board not printed, and reports the time per move. The
+// session is read once and played times over from memory.
+int script_mode(const vector<string>& args){
+    mapped_file file(args[1]);
+    if(!file.is_open()){
+        cout << "cannot open " << args[1] << endl;
+        return 1;
     }
-    if(understand_move(s, *this)){
-        cout << *this << endl;
-        if(to_play==white)
-            to_play=black;
-        else
-            to_play=white;
-        int x=check_state(*this);
-        if(x==1){
-            cout << "Checkmate, " << s1 << " wins!" << endl;
-            return;
-        }
-        else if(x==-1){
-            cout << "Stalemate, Draw!" << endl;
-            return;
+    string session(file.view());
+    int times=(args.size()>2 ? max(1, atoi(args[2].c_str())) : 1);
+    unsigned long long games=0;
+    auto start=chrono::steady_clock::now();
+    for(int i=0; i<times; i++){
+        istringstream in(session);
+        while(true){
+            chessboard B;
+            B.setup();
+            history.clear();
+            if(!B.play(in, cout, false, history, think_limits))
+                break;
+            games++;
         }
     }
-    else
-        cout << "invalid move" << endl;
-    play();
+    double seconds=chrono::duration<double>(chrono::steady_clock::now()-start).count();
+    cout << "Games: " << games << endl;
+    cout << "Moves: " << move_times.moves << endl;
+    cout << "Time: " << seconds << " s" << endl;
+    if(move_times.moves>0){
+        cout << "Time per move: " << move_times.seconds/move_times.moves*1e6 << " us" << endl;
+        cout << "Slowest move: " << move_times.slowest*1e6 << " us" << endl;
+    }
+    return 0;
 }
 
-void chessboard:: setup(const string &s){
-    char i='a';
-    int j=8, spaces=0;
-    for(int pl=0; pl<s.size(); pl++){
-        char x=s[pl];
-        if(x==' '){
-            spaces++;
-            continue;
+int main(int argc, char* argv[]){
+    vector<string> args;
+    for(int i=1; i<argc; i++){
+        string a=argv[i];
+        if(a.compare(0, 8, "threads=")==0){
+            think_limits.threads=max(1, atoi(a.c_str()+8));
+            threads_given=true;
         }
-        if(spaces==0){
-            if(isalpha(x)){
-                if(x=='r')
-                    access({i, j})=new Rook({i, j}, black);
-                else if(x=='b')
-                    access({i, j})=new Bishop({i, j}, black);
-                else if(x=='q')
-                    access({i, j})=new Queen({i, j}, black);
-                else if(x=='n')
-                    access({i, j})=new Knight({i, j}, black);
-                else if(x=='p')
-                    access({i, j})=new Pawn({i, j}, black);
-                else if(x=='k'){
-                    access({i, j})=new King({i, j}, black);
-                    black_player.king={i, j};
-                }
-                else if(x=='R')
-                    access({i, j})=new Rook({i, j}, white);
-                else if(x=='B')
-                    access({i, j})=new Bishop({i, j}, white);
-                else if(x=='Q')
-                    access({i, j})=new Queen({i, j}, white);
-                else if(x=='N')
-                    access({i, j})=new Knight({i, j}, white);
-                else if(x=='P')
-                    access({i, j})=new Pawn({i, j}, white);
-                else if(x=='K'){
-                    access({i, j})=new King({i, j}, white);
-                    white_player.king={i, j};
-                }
-                i++;
-            }
-            else if(isdigit(x)) i=i+x-'0';
-            else if(x=='/'){
-                j--;
-                i='a';
+        else if(a.compare(0, 5, "book=")==0){
+            book=make_unique<opening_book>(a.substr(5));
+            if(!book->is_open()){
+                cerr << "cannot open the book " << a.substr(5) << " with polyglot.keys beside it" << endl;
+                return 1;
             }
-        }  
-        else if(spaces==1){
-            if(x=='w')
-                to_play=white;
-            else
-                to_play=black;
         }
-        else if(spaces==2){
-            if(x=='K')
-                white_player.shortcastleright=true;
-            else if(x=='Q')
-                white_player.longcastleright=true;
-            else if(x=='k')
-                black_player.shortcastleright=true;
-            else if(x=='q')
-                black_player.longcastleright=true;
-            }
-        else{
-            if(isalpha(x)){
-                if(to_play==white)
-                    black_player.lastmove.first.first=black_player.lastmove.second.first=x;
-                else
-                    white_player.lastmove.first.first=white_player.lastmove.second.first=x;
+        else if(a.compare(0, 5, "nnue=")==0){
+            if(!network.load(a.substr(5))){
+                cerr << "cannot read the network " << a.substr(5) << endl;
+                return 1;
             }
-            else if(isdigit(x)){
-                if(to_play==white){
-                    black_player.lastmove.first.second=x+1-'0';
-                    black_player.lastmove.second.second=x-1-'0';
-                }
-                else{
-                    white_player.lastmove.first.second=x-1-'0';
-                    white_player.lastmove.second.second=x+1-'0';
-                }
+            nnue_net=&network;
+        }
+        else if(a.compare(0, 11, "tablebases=")==0){
+            tablebases=make_unique<tablebase>(a.substr(11));
+            if(tablebases->size()==0){
+                cerr << "no tablebases in " << a.substr(11) << endl;
+                return 1;
             }
         }
+        else
+            args.push_back(a);
+    }
+    if(!args.empty()){
+        if((args[0]=="perft" || args[0]=="divide") && args.size()>1)
+            return perft_mode(args);
+        if(args[0]=="analyse" && args.size()>1)
+            return analyse_mode(args);
+        if(args[0]=="replay" && args.size()>1)
+            return replay_mode(args);
+        if(args[0]=="--script" && args.size()>1)
+            return script_mode(args);
+        if(args[0]=="tablebase" && args.size()>1){
+            int threads=(threads_given ? think_limits.threads : max(1u, thread::hardware_concurrency()));
+            int pieces=(args.size()>2 ? atoi(args[2].c_str()) : 4);
+            return generate_tablebases(args[1], min(pieces, 4), threads, cout);
+        }
+        if(args[0]=="serve" && args.size()>1){
+            int workers=(threads_given ? think_limits.threads : max(1u, thread::hardware_concurrency()));
+            // The workers are the server's threads: a session cannot ask
+            // for more.
+            search_limits limits=think_limits;
+            limits.threads=limits.max_threads=1;
+            return serve(args[1], workers, limits);
+        }
+        cout << "usage: chess [threads=N] [book=<file.bin>] [nnue=<file>] [tablebases=<dir>] [perft|divide <depth> [fen] | analyse <milliseconds> [fen] | replay <file.pgn> | --script <session> [times] | serve <port|socket path> | tablebase <dir> [pieces]]" << endl;
+        return 1;
     }
-    cout << *this;
-}
-
-int main(){
     chessboard B;
     B.setup();
-    B.play(); 
+    cout << B;
+    B.play(cin, cout, true, history, think_limits);
 }
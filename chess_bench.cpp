@@ -0,0 +1,229 @@
+/* Micro-benchmarks of the functions the tool spends its time in, with
+the results as JSON, to compare one build against another.
+
+usage: chess_bench [seconds] [file.epd]   (default 0.2)
+
+The corpus is a set of positions, one per line of the EPD file or the
+positions below, and random games played from each of them: every
+position of the games, and every move in algebraic notation. Each
+benchmark goes over the corpus again and again for at least the given
+number of seconds and reports the time per call. move_index::build and
+check_state are called without a legal_cache, so both work the legal
+moves out each time, as on the first look at a new position.
+
+The JSON goes to standard output; exits with 1 if a position of the
+corpus is not a valid FEN or one of its moves is not understood.
+*/
+
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include "board.h"
+#include "eval.h"
+#include "pgn.h"
+
+const string_view positions[]={
+    def,
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "rnbqkb1r/pp1p1ppp/4pn2/2p5/2PP4/2N5/PP2PPPP/R1BQKBNR w KQkq - 0 4",
+    "r1bqkbnr/pppp1ppp/2n5/4p3/3PP3/5N2/PPP2PPP/RNBQKB1R b KQkq d3 0 3",
+    "2r3k1/5pp1/p3p2p/1p1bP3/3P4/P2B1N2/1P3PPP/6K1 w - - 0 28",
+    "8/5k2/3p4/1p1Pp2p/pP2Pp1P/P4P1K/8/8 b - - 99 50",
+};
+
+struct game{
+    string_view fen;
+    vector<string> san;
+};
+
+struct result{
+    string name;
+    long long calls;
+    double seconds;
+};
+
+static long long sink=0;
+static chessboard copy_target;
+
+// Runs pass, which goes over the corpus once and returns the number of
+// calls it made, until min_seconds have gone by.
+template<class F>
+static result measure(const string& name, double min_seconds, F pass){
+    result r{name, 0, 0};
+    auto start=chrono::steady_clock::now();
+    do{
+        r.calls+=pass();
+        r.seconds=chrono::duration<double>(chrono::steady_clock::now()-start).count();
+    }while(r.seconds<min_seconds);
+    return r;
+}
+
+int main(int argc, char* argv[]){
+    double min_seconds=(argc>1 ? atof(argv[1]) : 0.2);
+    mapped_file file(argc>2 ? argv[2] : "");
+    if(min_seconds<=0 || (argc>2 && !file.is_open())){
+        cout << "usage: chess_bench [seconds] [file.epd]" << endl;
+        return 1;
+    }
+    vector<string_view> fens(begin(positions), end(positions));
+    if(argc>2){
+        fens.clear();
+        string_view text=file.view(), line;
+        while(next_line(text, line))
+            if(!line.empty())
+                fens.push_back(line.substr(0, line.find(';')));
+    }
+    for(string_view fen: fens)
+        if(!chessboard().setup(fen)){
+            cout << "invalid FEN: " << fen << endl;
+            return 1;
+        }
+
+    // Four random games of up to 100 plies from every position.
+    mt19937 rng(1);
+    vector<game> games;
+    vector<chessboard> boards;
+    for(string_view fen: fens)
+        for(int i=0; i<4; i++){
+            game g{fen, {}};
+            chessboard B;
+            B.setup(fen);
+            Undo u;
+            while(g.san.size()<100){
+                MoveList list;
+                legal_moves(B, list);
+                if(list.count==0)
+                    break;
+                boards.push_back(B);
+                Move m=list.moves[rng() % list.count];
+                g.san.push_back(move_to_san(B, m));
+                B.make_move(m, u);
+            }
+            games.push_back(g);
+        }
+    vector<MoveList> moves(boards.size());
+    vector<pair<int, int>> pieces[6];     // board and square, by piece type
+    long long san_moves=0;
+    for(size_t i=0; i<boards.size(); i++){
+        legal_moves(boards[i], moves[i]);
+        bitboard b=boards[i].occupied[boards[i].to_play];
+        while(b){
+            int s=pop_lsb(b);
+            pieces[boards[i].at(s).type()].push_back({int(i), s});
+        }
+    }
+    for(const game& g: games)
+        san_moves+=g.san.size();
+
+    vector<result> results;
+    auto add=[&](const string& name, auto pass){
+        results.push_back(measure(name, min_seconds, pass));
+    };
+    add("chessboard::access", [&]{
+        for(chessboard& B: boards)
+            for(char f='a'; f<='h'; f++)
+                for(int r=1; r<=8; r++)
+                    sink+=B.access({f, r}).code;
+        return 64LL*boards.size();
+    });
+    const char* names[6]={"pawn", "knight", "bishop", "rook", "queen", "king"};
+    for(int t=pawn; t<=king; t++)
+        add(string("moveable_to ")+names[t], [&]{
+            for(auto [i, s]: pieces[t]){
+                MoveList list;
+                moveable_to(boards[i], s, list);
+                sink+=list.count;
+            }
+            return (long long)pieces[t].size();
+        });
+    add("chessboard::is_square_attacked", [&]{
+        for(chessboard& B: boards)
+            for(char f='a'; f<='h'; f++)
+                for(int r=1; r<=8; r++)
+                    sink+=B.is_square_attacked({f, r}, white)+B.is_square_attacked({f, r}, black);
+        return 128LL*boards.size();
+    });
+    add("legal_moves", [&]{
+        for(chessboard& B: boards){
+            MoveList list;
+            legal_moves(B, list);
+            sink+=list.count;
+        }
+        return (long long)boards.size();
+    });
+    add("chessboard copy", [&]{
+        for(chessboard& B: boards){
+            copy_target=B;
+            sink+=copy_target.key;
+        }
+        return (long long)boards.size();
+    });
+    add("move_index::build", [&]{
+        move_index index;
+        for(chessboard& B: boards){
+            index.build(B);
+            sink+=index.from[pawn][0];
+        }
+        return (long long)boards.size();
+    });
+    bool understood=true;
+    add("understand_move", [&]{
+        for(const game& g: games){
+            chessboard B;
+            B.setup(g.fen);
+            for(const string& s: g.san)
+                understood=understand_move(s, B) && understood;
+        }
+        return san_moves;
+    });
+    add("check_state", [&]{
+        for(chessboard& B: boards)
+            sink+=check_state(B);
+        return (long long)boards.size();
+    });
+    add("chessboard::setup", [&]{
+        for(string_view fen: fens){
+            chessboard B;
+            B.setup(fen);
+            sink+=B.key;
+        }
+        return (long long)fens.size();
+    });
+    add("make_move and unmake_move", [&]{
+        long long n=0;
+        for(size_t i=0; i<boards.size(); i++)
+            for(Move m: moves[i]){
+                Undo u;
+                boards[i].make_move(m, u);
+                boards[i].unmake_move(u);
+            }
+        for(const MoveList& list: moves)
+            n+=list.count;
+        return n;
+    });
+    add("evaluate", [&]{
+        for(chessboard& B: boards)
+            sink+=evaluate(B);
+        return (long long)boards.size();
+    });
+
+    cout << "{\n"
+         << "  \"corpus\": {\"positions\": " << fens.size() << ", \"games\": " << games.size()
+         << ", \"boards\": " << boards.size() << ", \"san_moves\": " << san_moves << "},\n"
+         << "  \"min_seconds\": " << min_seconds << ",\n"
+         << "  \"benchmarks\": [\n";
+    for(size_t i=0; i<results.size(); i++){
+        const result& r=results[i];
+        cout << "    {\"name\": \"" << r.name << "\", \"calls\": " << r.calls
+             << ", \"seconds\": " << r.seconds << ", \"ns_per_call\": " << r.seconds*1e9/r.calls << "}"
+             << (i+1<results.size() ? "," : "") << "\n";
+    }
+    cout << "  ],\n  \"check\": " << sink % 1000 << "\n}" << endl;
+    if(!understood)
+        cerr << "a move of the corpus was not understood" << endl;
+    return understood ? 0 : 1;
+}
@@ -0,0 +1,200 @@
+#include <cassert>
+#include <climits>
+#include "eval.h"
+#include "nnue.h"
+
+// The squares of each file and of the files beside it, and the squares
+// in front of a pawn, on its file and the two beside, that an enemy pawn
+// must hold to stop it.
+struct pawn_masks{
+    bitboard file[8];
+    bitboard adjacent[8];
+    bitboard passed[2][64];
+};
+
+constexpr pawn_masks make_pawn_masks(){
+    pawn_masks m{};
+    for(int f=0; f<8; f++)
+        m.file[f]=0x0101010101010101ULL << f;
+    for(int f=0; f<8; f++)
+        m.adjacent[f]=(f>0 ? m.file[f-1] : 0) | (f<7 ? m.file[f+1] : 0);
+    for(int s=0; s<64; s++){
+        bitboard span=m.file[s%8] | m.adjacent[s%8];
+        int rank=s/8;
+        m.passed[white][s]=(rank<7 ? span << 8*(rank+1) : 0);
+        m.passed[black][s]=(rank>0 ? span >> 8*(8-rank) : 0);
+    }
+    return m;
+}
+
+static constexpr pawn_masks masks=make_pawn_masks();
+
+const tapered doubled_pawn={-10, -20};
+const tapered isolated_pawn={-10, -15};
+// by rank from the pawn's own side, the second rank being 1
+const tapered passed_pawn[8]={{0, 0}, {5, 10}, {10, 20}, {20, 35}, {35, 60}, {60, 100}, {100, 150}, {0, 0}};
+// per square a piece can go to, knight to queen
+const tapered mobility_bonus[6]={{0, 0}, {4, 4}, {5, 5}, {2, 4}, {1, 2}, {0, 0}};
+// per attacked square next to the enemy king, knight to queen
+const int king_attack_units[6]={0, 2, 2, 3, 5, 0};
+const int pawn_shield[2]={12, 6};     // a pawn one or two squares in front
+// more than mobility and king safety add up to in almost any position
+const int lazy_margin=400;
+
+static int blend(tapered t, int phase){
+    int p=min(phase, max_phase);
+    return (t.mg*p+t.eg*(max_phase-p))/max_phase;
+}
+
+static void add(tapered& t, tapered v, Color c){
+    if(c==white)
+        t+=v;
+    else
+        t-=v;
+}
+
+static bitboard pawn_attacks(bitboard pawns, Color c){
+    const bitboard not_a=~masks.file[0], not_h=~masks.file[7];
+    if(c==white)
+        return (pawns << 7 & not_h) | (pawns << 9 & not_a);
+    return (pawns >> 9 & not_h) | (pawns >> 7 & not_a);
+}
+
+static tapered pawn_structure(const chessboard& B){
+    tapered t;
+    for(int c=0; c<2; c++){
+        bitboard own=B.pieces[c][pawn], enemy=B.pieces[!c][pawn];
+        for(int f=0; f<8; f++){
+            int n=popcount(own & masks.file[f]);
+            for(int i=1; i<n; i++)
+                add(t, doubled_pawn, Color(c));
+        }
+        bitboard b=own;
+        while(b){
+            int s=pop_lsb(b);
+            if(!(own & masks.adjacent[s%8]))
+                add(t, isolated_pawn, Color(c));
+            if(!(enemy & masks.passed[c][s]))
+                add(t, passed_pawn[c==white ? s/8 : 7-s/8], Color(c));
+        }
+    }
+    return t;
+}
+
+// Pawn structure by the key of the pawns. An empty entry has key 0 and
+// scores 0, which is right for a board without pawns.
+struct pawn_entry{
+    bitboard key;
+    int16_t mg, eg;
+};
+
+static thread_local pawn_entry pawn_cache[1 << 14];
+
+static tapered cached_pawn_structure(const chessboard& B){
+    pawn_entry& e=pawn_cache[B.pawn_key & ((1 << 14)-1)];
+    if(e.key!=B.pawn_key){
+        tapered t=pawn_structure(B);
+        e={B.pawn_key, int16_t(t.mg), int16_t(t.eg)};
+    }
+    return {e.mg, e.eg};
+}
+
+// Mobility counts the squares a piece attacks that are neither its own
+// side's nor covered by an enemy pawn. King safety is a middlegame term:
+// the pawns in front of a king on its first two ranks, and a penalty
+// growing with the square of the attacks on the squares around it, once
+// two pieces take part.
+static void piece_activity(const chessboard& B, tapered& mobility, tapered& king_safety){
+    for(int c=0; c<2; c++){
+        Color e=Color(!c);
+        bitboard area=~B.occupied[c] & ~pawn_attacks(B.pieces[e][pawn], e);
+        int ks=__builtin_ctzll(B.pieces[e][king]);
+        bitboard zone=attacks.king[ks] | 1ULL << ks;
+        int units=0, attackers=0;
+        for(int t=knight; t<=queen; t++){
+            bitboard b=B.pieces[c][t];
+            while(b){
+                int s=pop_lsb(b);
+                bitboard a;
+                if(t==knight)
+                    a=attacks.knight[s];
+                else if(t==bishop)
+                    a=bishop_attacks(s, B.all);
+                else if(t==rook)
+                    a=rook_attacks(s, B.all);
+                else
+                    a=rook_attacks(s, B.all) | bishop_attacks(s, B.all);
+                int n=popcount(a & area);
+                add(mobility, {mobility_bonus[t].mg*n, mobility_bonus[t].eg*n}, Color(c));
+                if(a & zone){
+                    attackers++;
+                    units+=king_attack_units[t]*popcount(a & zone);
+                }
+            }
+        }
+        if(attackers>=2)
+            add(king_safety, {min(units*units/4, 500), 0}, Color(c));
+
+        int own=__builtin_ctzll(B.pieces[c][king]);
+        int rank=(c==white ? own/8 : 7-own/8);
+        if(rank<=1){
+            bitboard files=masks.file[own%8] | masks.adjacent[own%8];
+            bitboard row=files & 0xffULL << (own & 56);
+            bitboard pawns=B.pieces[c][pawn];
+            int near=popcount((c==white ? row << 8 : row >> 8) & pawns);
+            int far=popcount((c==white ? row << 16 : row >> 16) & pawns);
+            add(king_safety, {pawn_shield[0]*near+pawn_shield[1]*far, 0}, Color(c));
+        }
+    }
+}
+
+#ifndef NDEBUG
+static bool incremental_sums_agree(const chessboard& B){
+    tapered t;
+    int phase=0;
+    for(int s=0; s<64; s++){
+        Piece p=B.at(s);
+        if(p.empty())
+            continue;
+        t+=piece_square.value[p.color()][p.type()][s];
+        phase+=piece_square.phase[p.type()];
+    }
+    return t.mg==B.psq_mg && t.eg==B.psq_eg && phase==B.phase;
+}
+#endif
+
+int evaluate(chessboard& B){
+    return evaluate(B, INT_MIN, INT_MAX);
+}
+
+int evaluate(chessboard& B, int alpha, int beta){
+    if(nnue_net)
+        return nnue_evaluate(B);
+    assert(incremental_sums_agree(B));
+    tapered t={B.psq_mg, B.psq_eg};
+    t+=cached_pawn_structure(B);
+    int score=blend(t, B.phase);
+    int own=(B.to_play==white ? score : -score);
+    if(own-lazy_margin>=beta || own+lazy_margin<=alpha)
+        return own;
+    piece_activity(B, t, t);
+    score=blend(t, B.phase);
+    return B.to_play==white ? score : -score;
+}
+
+eval_terms evaluate_terms(chessboard& B){
+    tapered material={B.psq_mg, B.psq_eg}, pawns=cached_pawn_structure(B), mobility, king_safety;
+    piece_activity(B, mobility, king_safety);
+    tapered all=material;
+    all+=pawns;
+    all+=mobility;
+    all+=king_safety;
+    eval_terms e;
+    e.material=blend(material, B.phase);
+    e.mobility=blend(mobility, B.phase);
+    e.pawns=blend(pawns, B.phase);
+    e.king_safety=blend(king_safety, B.phase);
+    e.phase=min(B.phase, max_phase);
+    e.total=blend(all, B.phase);
+    return e;
+}
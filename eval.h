@@ -0,0 +1,153 @@
+/* Static evaluation, in centipawns.
+
+Every term has a middlegame and an endgame value, blended by the phase
+of the game: the knights, bishops, rooks and queens left on the board.
+
+Material and the piece-square tables are summed by place() and remove()
+as pieces come and go, like the key, so they cost nothing to read.
+Mobility and king safety look at the attacks of every piece each time,
+unless the rest already settles the search window.
+Pawn structure (doubled, isolated and passed pawns) is kept in a cache
+per thread, indexed by a key of the pawns alone, since most positions
+of a search share their pawns with many others.
+
+With a network loaded (see nnue.h), evaluate() asks it instead, summing
+its accumulators afresh; the search keeps them ply by ply and asks the
+network itself.
+*/
+
+#ifndef EVAL_H
+#define EVAL_H
+
+#include "board.h"
+
+// A middlegame and an endgame value.
+struct tapered{
+    int mg=0, eg=0;
+    tapered& operator+=(tapered t){mg+=t.mg; eg+=t.eg; return *this;}
+    tapered& operator-=(tapered t){mg-=t.mg; eg-=t.eg; return *this;}
+};
+
+const int max_phase=24;
+
+// Material and square bonus of every piece on every square, for white
+// positive and for black negative, and what each piece adds to the phase.
+struct piece_square_tables{
+    tapered value[2][6][64];
+    int phase[6];
+};
+
+// The square bonuses from white's side, a8 first as on a diagram.
+constexpr int pawn_mg_squares[64]={
+      0,   0,   0,   0,   0,   0,   0,   0,
+     50,  50,  50,  50,  50,  50,  50,  50,
+     10,  10,  20,  30,  30,  20,  10,  10,
+      5,   5,  10,  25,  25,  10,   5,   5,
+      0,   0,   0,  20,  20,   0,   0,   0,
+      5,  -5, -10,   0,   0, -10,  -5,   5,
+      5,  10,  10, -20, -20,  10,  10,   5,
+      0,   0,   0,   0,   0,   0,   0,   0};
+constexpr int pawn_eg_squares[64]={
+      0,   0,   0,   0,   0,   0,   0,   0,
+     60,  60,  60,  60,  60,  60,  60,  60,
+     40,  40,  40,  40,  40,  40,  40,  40,
+     25,  25,  25,  25,  25,  25,  25,  25,
+     12,  12,  12,  12,  12,  12,  12,  12,
+      5,   5,   5,   5,   5,   5,   5,   5,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0};
+constexpr int knight_squares[64]={
+    -50, -40, -30, -30, -30, -30, -40, -50,
+    -40, -20,   0,   0,   0,   0, -20, -40,
+    -30,   0,  10,  15,  15,  10,   0, -30,
+    -30,   5,  15,  20,  20,  15,   5, -30,
+    -30,   0,  15,  20,  20,  15,   0, -30,
+    -30,   5,  10,  15,  15,  10,   5, -30,
+    -40, -20,   0,   5,   5,   0, -20, -40,
+    -50, -40, -30, -30, -30, -30, -40, -50};
+constexpr int bishop_squares[64]={
+    -20, -10, -10, -10, -10, -10, -10, -20,
+    -10,   0,   0,   0,   0,   0,   0, -10,
+    -10,   0,   5,  10,  10,   5,   0, -10,
+    -10,   5,   5,  10,  10,   5,   5, -10,
+    -10,   0,  10,  10,  10,  10,   0, -10,
+    -10,  10,  10,  10,  10,  10,  10, -10,
+    -10,   5,   0,   0,   0,   0,   5, -10,
+    -20, -10, -10, -10, -10, -10, -10, -20};
+constexpr int rook_squares[64]={
+      0,   0,   0,   0,   0,   0,   0,   0,
+      5,  10,  10,  10,  10,  10,  10,   5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+      0,   0,   0,   5,   5,   0,   0,   0};
+constexpr int queen_squares[64]={
+    -20, -10, -10,  -5,  -5, -10, -10, -20,
+    -10,   0,   0,   0,   0,   0,   0, -10,
+    -10,   0,   5,   5,   5,   5,   0, -10,
+     -5,   0,   5,   5,   5,   5,   0,  -5,
+      0,   0,   5,   5,   5,   5,   0,  -5,
+    -10,   5,   5,   5,   5,   5,   0, -10,
+    -10,   0,   5,   0,   0,   0,   0, -10,
+    -20, -10, -10,  -5,  -5, -10, -10, -20};
+// Sheltered on the back rank while there are pieces to attack it, in
+// the centre once they are gone.
+constexpr int king_mg_squares[64]={
+    -30, -40, -40, -50, -50, -40, -40, -30,
+    -30, -40, -40, -50, -50, -40, -40, -30,
+    -30, -40, -40, -50, -50, -40, -40, -30,
+    -30, -40, -40, -50, -50, -40, -40, -30,
+    -20, -30, -30, -40, -40, -30, -30, -20,
+    -10, -20, -20, -20, -20, -20, -20, -10,
+     20,  20,   0,   0,   0,   0,  20,  20,
+     20,  30,  10,   0,   0,  10,  30,  20};
+constexpr int king_eg_squares[64]={
+    -50, -40, -30, -20, -20, -30, -40, -50,
+    -30, -20, -10,   0,   0, -10, -20, -30,
+    -30, -10,  20,  30,  30,  20, -10, -30,
+    -30, -10,  30,  40,  40,  30, -10, -30,
+    -30, -10,  30,  40,  40,  30, -10, -30,
+    -30, -10,  20,  30,  30,  20, -10, -30,
+    -30, -30,   0,   0,   0,   0, -30, -30,
+    -50, -30, -30, -30, -30, -30, -30, -50};
+
+constexpr piece_square_tables make_piece_square_tables(){
+    const tapered material[6]={{82, 94}, {337, 281}, {365, 297}, {477, 512}, {1025, 936}, {0, 0}};
+    const int* mg[6]={pawn_mg_squares, knight_squares, bishop_squares, rook_squares, queen_squares, king_mg_squares};
+    const int* eg[6]={pawn_eg_squares, knight_squares, bishop_squares, rook_squares, queen_squares, king_eg_squares};
+    piece_square_tables t{};
+    for(int p=pawn; p<=king; p++)
+        for(int s=0; s<64; s++){
+            // a8 is entry 0 for white; black sees the board upside down
+            int w=s^56;
+            t.value[white][p][s]={material[p].mg+mg[p][w], material[p].eg+eg[p][w]};
+            t.value[black][p][s]={-material[p].mg-mg[p][s], -material[p].eg-eg[p][s]};
+        }
+    int phase[6]={0, 1, 1, 2, 4, 0};
+    for(int p=pawn; p<=king; p++)
+        t.phase[p]=phase[p];
+    return t;
+}
+
+inline constexpr piece_square_tables piece_square=make_piece_square_tables();
+
+// The terms from white's side, each blended by the phase.
+struct eval_terms{
+    int material;       // with the piece-square tables
+    int mobility;
+    int pawns;
+    int king_safety;
+    int phase;          // max_phase with every piece on the board
+    int total;
+};
+
+// From the side to play's point of view. Given a window, a position
+// whose material and pawns alone are far outside it is not looked at
+// further, and that partial score is returned.
+int evaluate(chessboard& B);
+int evaluate(chessboard& B, int alpha, int beta);
+eval_terms evaluate_terms(chessboard& B);
+
+#endif
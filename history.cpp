@@ -0,0 +1,92 @@
+#include "history.h"
+
+static uint8_t castling_rights(chessboard& B){
+    return B.white_player.shortcastleright | B.white_player.longcastleright << 1
+         | B.black_player.shortcastleright << 2 | B.black_player.longcastleright << 3;
+}
+
+void game_history:: clear(){
+    entries.clear();
+    current=0;
+}
+
+void game_history:: play(chessboard& B, Move m){
+    history_entry h;
+    h.move=m;
+    h.captured=(m.kind()==move_en_passant ? Piece(pawn, opponent(B.to_play)) : B.at(m.to()));
+    h.castling=castling_rights(B);
+    plain_pair<pci, pci> last=B.returnPlayer(B.to_play).lastmove;
+    h.lastmove=(last.first.second==0 ? Move() : Move(square_index(last.first), square_index(last.second)));
+    h.halfmove_clock=B.halfmove_clock;
+    h.key=B.key;
+    Undo u;
+    B.make_move(m, u);
+    entries.resize(current);
+    entries.push_back(h);
+    current++;
+}
+
+// Rebuilds the Undo that make_move() filled in from the record and the
+// position after the move.
+bool game_history:: undo(chessboard& B){
+    if(current==0)
+        return false;
+    const history_entry& h=entries[--current];
+    Color c=opponent(B.to_play);
+    Undo u;
+    u.initial_position=h.move.initial_position();
+    u.position=h.move.position();
+    u.moved=(h.move.kind()==move_promotion ? Piece(pawn, c) : B.at(h.move.to()));
+    u.captured=h.captured;
+    u.captured_position=u.position;
+    if(h.move.kind()==move_en_passant)
+        u.captured_position={u.position.first, u.initial_position.second};
+    u.key=h.key;
+    u.to_play=c;
+    u.halfmove_clock=h.halfmove_clock;
+    u.white_player=B.white_player;
+    u.black_player=B.black_player;
+    u.white_player.shortcastleright=h.castling & 1;
+    u.white_player.longcastleright=h.castling >> 1 & 1;
+    u.black_player.shortcastleright=h.castling >> 2 & 1;
+    u.black_player.longcastleright=h.castling >> 3 & 1;
+    chessboard::Player& p=(c==white ? u.white_player : u.black_player);
+    if(u.moved.type()==king)
+        p.king=u.initial_position;
+    if(h.lastmove==Move())
+        p.lastmove={{' ', 0}, {' ', 0}};
+    else
+        p.lastmove={h.lastmove.initial_position(), h.lastmove.position()};
+    B.unmake_move(u);
+    return true;
+}
+
+bool game_history:: redo(chessboard& B){
+    if(current==size())
+        return false;
+    Move m=entries[current].move;
+    Undo u;
+    B.make_move(m, u);
+    current++;
+    return true;
+}
+
+bool game_history:: go_to(chessboard& B, int ply){
+    if(ply<0 || ply>size())
+        return false;
+    while(current>ply)
+        undo(B);
+    while(current<ply)
+        redo(B);
+    return true;
+}
+
+// How often the position on the board has occurred, this time included.
+// Only every other ply has the same side to play.
+int game_history:: repetitions(const chessboard& B) const{
+    int n=1;
+    for(int i=current-2; i>=0 && i>=current-B.halfmove_clock; i-=2)
+        if(entries[i].key==B.key)
+            n++;
+    return n;
+}
@@ -0,0 +1,51 @@
+/* Game history: the moves played so far, so that they can be taken back
+and played again without replaying the game from setup().
+
+Each ply keeps a 16-byte record: the move, the piece it captured, and
+the castling rights, the mover's last move, the halfmove clock and the
+key from before it.
+Together with the position after the move that is all unmake_move()
+needs, so undo and redo cost one unmake or make each. A new move after
+an undo drops the moves that were taken back.
+
+The keys also give repetitions, threefold and fivefold. A capture or pawn move can
+never be undone over the board, so only the positions since the last
+one, halfmove_clock plies, have to be compared.
+*/
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "board.h"
+
+struct history_entry{
+    Move move;
+    Piece captured;
+    uint8_t castling;      // bit 0 white short, 1 white long, 2 black short, 3 black long
+    Move lastmove;         // the mover's last move before this one, or Move()
+    uint16_t halfmove_clock;
+    bitboard key;          // before the move
+};
+
+class game_history{
+public:
+    void clear();
+    void play(chessboard& B, Move m);
+    bool undo(chessboard& B);
+    bool redo(chessboard& B);
+    bool go_to(chessboard& B, int ply);    // false if ply is out of range
+    int repetitions(const chessboard& B) const;
+    int ply() const {return current;}      // moves played up to the position on the board
+    int size() const {return entries.size();}   // the same plus the moves taken back
+
+    // The legal moves of the position last asked about, for check_state()
+    // and reading the next move. They are kept by key, so moving through
+    // the history never needs to clear them.
+    legal_cache legal;
+
+private:
+    vector<history_entry> entries;
+    int current=0;
+};
+
+#endif
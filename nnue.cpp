@@ -0,0 +1,331 @@
+#include <cassert>
+#include <cstring>
+#include <random>
+#include "nnue.h"
+#include "pgn.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+const nnue_network* nnue_net=nullptr;
+
+nnue_kernel nnue_kernels=[]{
+#if defined(__x86_64__) || defined(__i386__)
+    if(__builtin_cpu_supports("avx2"))
+        return kernel_avx2;
+    if(__builtin_cpu_supports("sse2"))
+        return kernel_sse2;
+#endif
+    return kernel_plain;
+}();
+
+static uint64_t little_endian(const char* p, int bytes){
+    uint64_t x=0;
+    for(int i=bytes-1; i>=0; i--)
+        x=x << 8 | (unsigned char)p[i];
+    return x;
+}
+
+template<class T>
+static void read(const char*& p, vector<T>& v, size_t n){
+    v.resize(n);
+    for(size_t i=0; i<n; i++, p+=sizeof(T))
+        v[i]=T(little_endian(p, sizeof(T)));
+}
+
+bool nnue_network:: load(const string& path){
+    mapped_file f(path);
+    string_view v=f.view();
+    const int sizes[4]={nnue_inputs, nnue_width, nnue_layer1, nnue_layer2};
+    size_t length=20+2*nnue_width+2*size_t(nnue_inputs)*nnue_width
+        +4*nnue_layer1+nnue_layer1*2*nnue_width
+        +4*nnue_layer2+nnue_layer2*nnue_layer1
+        +4+nnue_layer2;
+    if(v.size()!=length || v.substr(0, 4)!="cnn1")
+        return false;
+    for(int i=0; i<4; i++)
+        if(little_endian(v.data()+4+4*i, 4)!=uint64_t(sizes[i]))
+            return false;
+    const char* p=v.data()+20;
+    read(p, input_bias, nnue_width);
+    read(p, input_weights, size_t(nnue_inputs)*nnue_width);
+    read(p, bias1, nnue_layer1);
+    read(p, weights1, nnue_layer1*2*nnue_width);
+    read(p, bias2, nnue_layer2);
+    read(p, weights2, nnue_layer2*nnue_layer1);
+    read(p, output_bias, 1);
+    read(p, output_weights, nnue_layer2);
+    return true;
+}
+
+void nnue_network:: randomize(uint64_t seed){
+    mt19937_64 rng(seed);
+    auto fill=[&](auto& v, size_t n, int low, int high){
+        uniform_int_distribution<int> d(low, high);
+        v.resize(n);
+        for(auto& x: v)
+            x=d(rng);
+    };
+    fill(input_bias, nnue_width, 0, 64);
+    fill(input_weights, size_t(nnue_inputs)*nnue_width, -4, 4);
+    fill(bias1, nnue_layer1, -64, 64);
+    fill(weights1, nnue_layer1*2*nnue_width, -8, 8);
+    fill(bias2, nnue_layer2, -64, 64);
+    fill(weights2, nnue_layer2*nnue_layer1, -32, 32);
+    fill(output_bias, 1, 0, 0);
+    fill(output_weights, nnue_layer2, -64, 64);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Adds or subtracts one column of the first layer.
+template<bool add>
+static void update_plain(int16_t* acc, const int16_t* w){
+    for(int i=0; i<nnue_width; i++)
+        acc[i]=int16_t(add ? acc[i]+w[i] : acc[i]-w[i]);
+}
+
+// Row j of the weights, n bytes, times the input, plus the bias.
+static void affine_plain(const uint8_t* in, int n, const int8_t* w, const int32_t* bias, int32_t* out, int rows){
+    for(int j=0; j<rows; j++){
+        int32_t sum=bias[j];
+        for(int i=0; i<n; i++)
+            sum+=in[i]*w[j*n+i];
+        out[j]=sum;
+    }
+}
+
+static void clip_plain(const int16_t* acc, uint8_t* out){
+    for(int i=0; i<nnue_width; i++)
+        out[i]=uint8_t(clamp<int>(acc[i], 0, 127));
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+template<bool add>
+__attribute__((target("sse2"))) static void update_sse2(int16_t* acc, const int16_t* w){
+    for(int i=0; i<nnue_width; i+=8){
+        __m128i* a=(__m128i*)(acc+i);
+        __m128i c=_mm_loadu_si128((const __m128i*)(w+i));
+        _mm_store_si128(a, add ? _mm_add_epi16(_mm_load_si128(a), c) : _mm_sub_epi16(_mm_load_si128(a), c));
+    }
+}
+
+template<bool add>
+__attribute__((target("avx2"))) static void update_avx2(int16_t* acc, const int16_t* w){
+    for(int i=0; i<nnue_width; i+=16){
+        __m256i* a=(__m256i*)(acc+i);
+        __m256i c=_mm256_loadu_si256((const __m256i*)(w+i));
+        _mm256_store_si256(a, add ? _mm256_add_epi16(_mm256_load_si256(a), c) : _mm256_sub_epi16(_mm256_load_si256(a), c));
+    }
+}
+
+// n a multiple of 32. maddubs multiplies the unsigned input bytes by the
+// signed weights and adds pairs into 16 bits, which cannot overflow since
+// no input is above 127.
+__attribute__((target("avx2"))) static void affine_avx2(const uint8_t* in, int n, const int8_t* w, const int32_t* bias, int32_t* out, int rows){
+    const __m256i ones=_mm256_set1_epi16(1);
+    for(int j=0; j<rows; j++){
+        __m256i sum=_mm256_setzero_si256();
+        for(int i=0; i<n; i+=32){
+            __m256i x=_mm256_loadu_si256((const __m256i*)(in+i));
+            __m256i y=_mm256_loadu_si256((const __m256i*)(w+j*n+i));
+            sum=_mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_maddubs_epi16(x, y), ones));
+        }
+        __m128i s=_mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        s=_mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4e));
+        s=_mm_add_epi32(s, _mm_shuffle_epi32(s, 0xb1));
+        out[j]=bias[j]+_mm_cvtsi128_si32(s);
+    }
+}
+
+// packus works within each 128-bit half, so the quarters are put back
+// in order afterwards.
+__attribute__((target("avx2"))) static void clip_avx2(const int16_t* acc, uint8_t* out){
+    const __m256i top=_mm256_set1_epi8(127);
+    for(int i=0; i<nnue_width; i+=32){
+        __m256i a=_mm256_load_si256((const __m256i*)(acc+i));
+        __m256i b=_mm256_load_si256((const __m256i*)(acc+i+16));
+        __m256i c=_mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xd8);
+        _mm256_storeu_si256((__m256i*)(out+i), _mm256_min_epu8(c, top));
+    }
+}
+#endif
+
+template<bool add>
+static void update(int16_t* acc, const int16_t* w){
+#if defined(__x86_64__) || defined(__i386__)
+    if(nnue_kernels==kernel_avx2)
+        return update_avx2<add>(acc, w);
+    if(nnue_kernels==kernel_sse2)
+        return update_sse2<add>(acc, w);
+#endif
+    update_plain<add>(acc, w);
+}
+
+static void affine(const uint8_t* in, int n, const int8_t* w, const int32_t* bias, int32_t* out, int rows){
+#if defined(__x86_64__) || defined(__i386__)
+    if(nnue_kernels==kernel_avx2 && n%32==0)
+        return affine_avx2(in, n, w, bias, out, rows);
+#endif
+    affine_plain(in, n, w, bias, out, rows);
+}
+
+static void clip(const int16_t* acc, uint8_t* out){
+#if defined(__x86_64__) || defined(__i386__)
+    if(nnue_kernels==kernel_avx2)
+        return clip_avx2(acc, out);
+#endif
+    clip_plain(acc, out);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// The input for a piece seen from one side with its king on k: the
+// pieces are numbered own pawn, enemy pawn, own knight, ..., and black
+// sees the board upside down.
+static const int16_t* column(Color view, int k, Piece p, int s){
+    if(view==black){
+        k^=56;
+        s^=56;
+    }
+    int piece=2*p.type()+(p.color()!=view);
+    return nnue_net->input_weights.data()+size_t((k*10+piece)*64+s)*nnue_width;
+}
+
+void nnue_refresh(const chessboard& B, nnue_accumulator& a, Color view){
+    int16_t* acc=a.values[view];
+    copy(nnue_net->input_bias.begin(), nnue_net->input_bias.end(), acc);
+    int k=__builtin_ctzll(B.pieces[view][king]);
+    bitboard b=B.all & ~B.pieces[white][king] & ~B.pieces[black][king];
+    while(b){
+        int s=pop_lsb(b);
+        update<true>(acc, column(view, k, B.at(s), s));
+    }
+}
+
+void nnue_stack:: reset(const chessboard& B){
+    top=0;
+    for(int v=0; v<2; v++){
+        nnue_refresh(B, entries[0].accumulator, Color(v));
+        entries[0].ready[v]=true;
+    }
+}
+
+void nnue_stack:: push(const chessboard& B, const Undo& u){
+    entry& e=entries[++top];
+    e.ready[white]=e.ready[black]=false;
+    e.king_moved[white]=e.king_moved[black]=false;
+    e.removed=e.count=0;
+    auto note=[&](Piece p, int s){
+        e.piece[e.count]=p;
+        e.square[e.count++]=int8_t(s);
+    };
+    int from=square_index(u.initial_position), to=square_index(u.position);
+    if(u.moved.type()==king){
+        e.king_moved[u.moved.color()]=true;
+        if(abs(to-from)==2){
+            int row=to & 56;
+            note(Piece(rook, u.moved.color()), row+(to>from ? 7 : 0));
+            e.removed=1;
+            note(Piece(rook, u.moved.color()), row+(to>from ? 5 : 3));
+        }
+        if(!u.captured.empty()){
+            note(u.captured, to);
+            e.removed=e.count;
+        }
+        return;
+    }
+    note(u.moved, from);
+    if(!u.captured.empty())
+        note(u.captured, square_index(u.captured_position));
+    e.removed=e.count;
+    note(B.at(to), to);
+}
+
+void nnue_stack:: push_null(){
+    entry& e=entries[++top];
+    e.ready[white]=e.ready[black]=false;
+    e.king_moved[white]=e.king_moved[black]=false;
+    e.removed=e.count=0;
+}
+
+// Adds a move's pieces to the accumulator from before it, forward, or
+// takes them back from the one after it.
+static void follow(int16_t* acc, Color view, int k, const Piece* piece, const int8_t* square, int removed, int count, bool forward){
+    for(int j=0; j<count; j++)
+        if((j<removed)==forward)
+            update<false>(acc, column(view, k, piece[j], square[j]));
+        else
+            update<true>(acc, column(view, k, piece[j], square[j]));
+}
+
+const nnue_accumulator& nnue_stack:: update(const chessboard& B){
+    for(int v=0; v<2; v++){
+        if(entries[top].ready[v])
+            continue;
+        int k=__builtin_ctzll(B.pieces[v][king]);
+        // Back to the last ply that is ready, or to the last move of this
+        // side's king, which changed all its inputs.
+        int i=top;
+        while(!entries[i].ready[v] && !entries[i].king_moved[v])
+            i--;
+        if(entries[i].ready[v])
+            for(i++; i<=top; i++){
+                entry& e=entries[i];
+                copy_n(entries[i-1].accumulator.values[v], nnue_width, e.accumulator.values[v]);
+                follow(e.accumulator.values[v], Color(v), k, e.piece, e.square, e.removed, e.count, true);
+                e.ready[v]=true;
+            }
+        else{
+            // Summed afresh here, then taken back to the king move, so that
+            // the other moves tried from the plies between find them ready.
+            nnue_refresh(B, entries[top].accumulator, Color(v));
+            entries[top].ready[v]=true;
+            refreshes++;
+            for(int j=top; j>i; j--){
+                entry& e=entries[j];
+                copy_n(e.accumulator.values[v], nnue_width, entries[j-1].accumulator.values[v]);
+                follow(entries[j-1].accumulator.values[v], Color(v), k, e.piece, e.square, e.removed, e.count, false);
+                entries[j-1].ready[v]=true;
+            }
+        }
+    }
+    return entries[top].accumulator;
+}
+
+#ifndef NDEBUG
+static bool accumulators_agree(const chessboard& B, const nnue_accumulator& a){
+    nnue_accumulator fresh;
+    for(int v=0; v<2; v++)
+        nnue_refresh(B, fresh, Color(v));
+    return memcmp(fresh.values, a.values, sizeof(a.values))==0;
+}
+#endif
+
+static void activate(const int32_t* in, uint8_t* out, int n){
+    for(int i=0; i<n; i++)
+        out[i]=uint8_t(clamp(in[i] >> 6, 0, 127));
+}
+
+int nnue_evaluate(const chessboard& B, const nnue_accumulator& a){
+    const nnue_network& N=*nnue_net;
+    assert(accumulators_agree(B, a));
+    alignas(32) uint8_t input[2*nnue_width];
+    clip(a.values[B.to_play], input);
+    clip(a.values[!B.to_play], input+nnue_width);
+    int32_t hidden1[nnue_layer1], hidden2[nnue_layer2], out;
+    alignas(32) uint8_t active1[nnue_layer1], active2[nnue_layer2];
+    affine(input, 2*nnue_width, N.weights1.data(), N.bias1.data(), hidden1, nnue_layer1);
+    activate(hidden1, active1, nnue_layer1);
+    affine(active1, nnue_layer1, N.weights2.data(), N.bias2.data(), hidden2, nnue_layer2);
+    activate(hidden2, active2, nnue_layer2);
+    affine(active2, nnue_layer2, N.output_weights.data(), N.output_bias.data(), &out, 1);
+    return out/16;
+}
+
+int nnue_evaluate(const chessboard& B){
+    nnue_accumulator a;
+    for(int v=0; v<2; v++)
+        nnue_refresh(B, a, Color(v));
+    return nnue_evaluate(B, a);
+}
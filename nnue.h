@@ -0,0 +1,98 @@
+/* Neural network evaluation (NNUE: an efficiently updatable network),
+on the CPU.
+
+The inputs are HalfKP: for each side's point of view, one per own king
+square, piece other than a king, and square, 64*10*64 in all, with the
+board turned upside down for black. A move changes only a few of them,
+so the first layer's output for each side, the accumulator, is carried
+along the search's line in an nnue_stack, one per ply next to its keys:
+make_move() leaves the board alone, and the stack notes the pieces each
+move took off and put on. A ply's accumulator is worked out from its
+parent's only when it is evaluated, adding and subtracting a column of
+weights per piece; a king move changes every input of its side, so that
+side is summed afresh instead. The moves legal_moves() tries and takes
+back never reach the stack.
+
+The rest is small. The two accumulators, the side to play's first, are
+clipped to 0..127 as bytes and go through two layers of 32 with 8-bit
+weights, then to one output, divided by 16 for centipawns. The column
+updates and the layers have AVX2 kernels used when the CPU has AVX2,
+SSE2 ones for the columns, and plain loops otherwise.
+
+The weights are read from the file given with nnue=<file>: "cnn1", the
+sizes 40960, 256, 32 and 32 as 32-bit numbers, then the first layer's
+biases and weights (16-bit, a column of 256 per input), and the biases
+(32-bit) and weights (8-bit, a row per output) of the three other
+layers, all little-endian.
+*/
+
+#ifndef NNUE_H
+#define NNUE_H
+
+#include "board.h"
+
+const int nnue_inputs=64*10*64;
+const int nnue_width=256;
+const int nnue_layer1=32;
+const int nnue_layer2=32;
+
+// The first layer's output for both points of view.
+struct nnue_accumulator{
+    alignas(32) int16_t values[2][nnue_width];
+};
+
+struct nnue_network{
+    vector<int16_t> input_bias, input_weights;
+    vector<int32_t> bias1, bias2, output_bias;
+    vector<int8_t> weights1, weights2, output_weights;
+    bool load(const string& path);
+    // Small random weights, for the benchmark.
+    void randomize(uint64_t seed);
+};
+
+// The network evaluate() uses, or null for the handcrafted evaluation.
+extern const nnue_network* nnue_net;
+
+enum nnue_kernel{kernel_plain, kernel_sse2, kernel_avx2};
+// The best the CPU can run, set at startup; lower it to compare.
+extern nnue_kernel nnue_kernels;
+
+// Sums a side's accumulator afresh.
+void nnue_refresh(const chessboard& B, nnue_accumulator& a, Color view);
+// From the side to play's point of view, in centipawns: with accumulators
+// that are up to date, or summed afresh for the position.
+int nnue_evaluate(const chessboard& B, const nnue_accumulator& a);
+int nnue_evaluate(const chessboard& B);
+
+// The accumulators along a line of moves from a root, one per ply.
+class nnue_stack{
+public:
+    explicit nnue_stack(int plies): entries(plies+1) {}
+    void reset(const chessboard& B);        // B is the root
+    // After make_move() or make_null_move(), and before the unmake.
+    void push(const chessboard& B, const Undo& u);
+    void push_null();
+    void pop() {top--;}
+    // Brings the accumulators of B, the position at the top, up to date.
+    const nnue_accumulator& update(const chessboard& B);
+    int evaluate(const chessboard& B) {return nnue_evaluate(B, update(B));}
+    unsigned long long refreshes=0;         // sides summed afresh
+
+private:
+    // The move into a ply as the inputs see it: the pieces it took off
+    // the board, then those it put on, at most three in all (a pawn that
+    // captures and promotes). Kings are not inputs, so a king move only
+    // marks its side, and castling leaves just the rook.
+    struct entry{
+        nnue_accumulator accumulator;
+        bool ready[2];
+        bool king_moved[2];
+        int removed, count;
+        Piece piece[3];
+        int8_t square[3];
+    };
+    vector<entry> entries;
+    int top=0;
+};
+
+#endif
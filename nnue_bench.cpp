@@ -0,0 +1,167 @@
+/* Network benchmark: how long keeping the accumulators of nnue.h up to
+date takes when they are summed afresh in every position, against
+following the moves in an nnue_stack.
+
+usage: nnue_bench [games]   (default 200)
+
+Plays that many random games of up to 160 plies, with a network of
+random weights of the real size, then replays them forward and back
+several ways and reports the time per position, for each set of
+kernels the CPU can run: make and unmake with the stack's push and pop
+alone, then on top of that a full refresh of both accumulators, the
+stack's update (a refresh after a king move, nothing on the way back),
+and the rest of the network.
+
+Last, as the search does at every node, it generates the legal moves of
+each position of the games, which makes and takes back every move to
+test it, and then evaluates each move from the stack. Each of those
+evaluations is checked against one summed afresh; the time per
+evaluation is reported with the share of sides summed afresh, which
+only king moves should need. Exits with 1 if an evaluation differs.
+*/
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <random>
+#include "board.h"
+#include "nnue.h"
+
+enum pass_kind{moves_only, full_refresh, incremental, forward_pass};
+
+static long long sink=0;
+
+static void after_move(const chessboard& B, pass_kind kind, nnue_stack& stack){
+    if(kind==full_refresh){
+        nnue_accumulator a;
+        nnue_refresh(B, a, white);
+        nnue_refresh(B, a, black);
+        sink+=a.values[0][0];
+    }
+    else if(kind==incremental)
+        sink+=stack.update(B).values[0][0];
+    else if(kind==forward_pass)
+        sink+=stack.evaluate(B);
+}
+
+// Seconds per position, every game played to its end and taken back.
+static double replay(const vector<vector<Move>>& games, pass_kind kind, nnue_stack& stack){
+    long long positions=0;
+    auto start=chrono::steady_clock::now();
+    for(const vector<Move>& game: games){
+        chessboard B;
+        B.setup();
+        stack.reset(B);
+        vector<Undo> undo(game.size());
+        for(size_t i=0; i<game.size(); i++){
+            B.make_move(game[i], undo[i]);
+            stack.push(B, undo[i]);
+            after_move(B, kind, stack);
+        }
+        for(size_t i=game.size(); i-->0;){
+            B.unmake_move(undo[i]);
+            stack.pop();
+            after_move(B, kind, stack);
+        }
+        positions+=2*game.size();
+    }
+    double seconds=chrono::duration<double>(chrono::steady_clock::now()-start).count();
+    return seconds/max(positions, 1LL);
+}
+
+// The legal moves of every position of the games, then an evaluation
+// after each. Returns seconds per evaluation; with check, counts in
+// wrong the evaluations that differ from ones summed afresh.
+static double expand(const vector<vector<Move>>& games, nnue_stack& stack, bool check, long long& evaluations, long long& wrong){
+    evaluations=0;
+    auto start=chrono::steady_clock::now();
+    for(const vector<Move>& game: games){
+        chessboard B;
+        B.setup();
+        stack.reset(B);
+        vector<Undo> undo(game.size());
+        for(size_t i=0; i<game.size(); i++){
+            MoveList list;
+            legal_moves(B, list);
+            for(Move m: list){
+                Undo u;
+                B.make_move(m, u);
+                stack.push(B, u);
+                int e=stack.evaluate(B);
+                if(check && e!=nnue_evaluate(B))
+                    wrong++;
+                sink+=e;
+                stack.pop();
+                B.unmake_move(u);
+            }
+            evaluations+=list.count;
+            B.make_move(game[i], undo[i]);
+            stack.push(B, undo[i]);
+        }
+    }
+    double seconds=chrono::duration<double>(chrono::steady_clock::now()-start).count();
+    return seconds/max(evaluations, 1LL);
+}
+
+int main(int argc, char* argv[]){
+    int count=(argc>1 ? atoi(argv[1]) : 200);
+    if(count<1){
+        cout << "usage: nnue_bench [games]" << endl;
+        return 1;
+    }
+    nnue_network N;
+    N.randomize(1);
+    nnue_net=&N;
+
+    mt19937 rng(1);
+    vector<vector<Move>> games(count);
+    long long plies=0;
+    for(vector<Move>& game: games){
+        chessboard B;
+        B.setup();
+        Undo u;
+        while(game.size()<160 && B.halfmove_clock<100){
+            MoveList list;
+            legal_moves(B, list);
+            if(list.count==0)
+                break;
+            Move m=list.moves[rng() % list.count];
+            game.push_back(m);
+            B.make_move(m, u);
+        }
+        plies+=game.size();
+    }
+    cout << count << " games, " << plies << " plies, each played forward and back" << endl;
+
+    // A ply for every move of a game and one for the moves tried after it.
+    nnue_stack stack(161);
+    const char* names[3]={"plain", "sse2", "avx2"};
+    nnue_kernel best=nnue_kernels;
+    long long wrong=0;
+    for(int k=best; k>=kernel_plain; k--){
+        nnue_kernels=nnue_kernel(k);
+        double base=replay(games, moves_only, stack);
+        double refresh=replay(games, full_refresh, stack)-base;
+        double update=replay(games, incremental, stack)-base;
+        double forward=replay(games, forward_pass, stack)-base-update;
+        long long evaluations;
+        expand(games, stack, true, evaluations, wrong);
+        unsigned long long refreshes=stack.refreshes;
+        double each=expand(games, stack, false, evaluations, wrong);
+        refreshes=stack.refreshes-refreshes;
+        cout << fixed << setprecision(1) << names[k] << " kernels\n"
+             << "  make and unmake alone " << setw(10) << base*1e9 << " ns/position\n"
+             << "  full refresh          " << setw(10) << refresh*1e9 << " ns/position\n"
+             << "  incremental update    " << setw(10) << update*1e9 << " ns/position, "
+             << refresh/max(update, 1e-12) << "x faster\n"
+             << "  rest of the network   " << setw(10) << forward*1e9 << " ns/position\n"
+             << "  legal moves, then each evaluated " << setw(10) << each*1e9 << " ns/evaluation, "
+             << 100.0*refreshes/(2*evaluations) << "% of sides summed afresh" << endl;
+    }
+    nnue_kernels=best;
+    nnue_net=nullptr;
+    cout << "check " << sink % 1000 << endl;
+    if(wrong)
+        cout << wrong << " evaluations differ from the accumulators summed afresh" << endl;
+    return wrong ? 1 : 0;
+}
@@ -0,0 +1,47 @@
+#include "perft.h"
+
+unsigned long long perft(chessboard& B, int depth){
+    if(depth==0)
+        return 1;
+    MoveList list;
+    legal_moves(B, list);
+    if(depth==1)
+        return list.size();
+    unsigned long long nodes=0;
+    for(int i=0; i<list.size(); i++){
+        Undo u;
+        B.make_move(list[i], u);
+        nodes+=perft(B, depth-1);
+        B.unmake_move(u);
+    }
+    return nodes;
+}
+
+// Same count, broken down by root move.
+unsigned long long divide(chessboard& B, int depth, ostream& out){
+    MoveList list;
+    legal_moves(B, list);
+    unsigned long long nodes=0;
+    for(int i=0; i<list.size(); i++){
+        Undo u;
+        B.make_move(list[i], u);
+        unsigned long long n=(depth>1 ? perft(B, depth-1) : 1);
+        B.unmake_move(u);
+        out << move_name(list[i]) << ": " << n << endl;
+        nodes+=n;
+    }
+    return nodes;
+}
+
+// Coordinate notation, as other engines print their divide output (e7e8q).
+string move_name(Move m){
+    pci from=m.initial_position(), to=m.position();
+    string s;
+    s+=from.first;
+    s+=char('0'+from.second);
+    s+=to.first;
+    s+=char('0'+to.second);
+    if(m.kind()==move_promotion)
+        s+=char(tolower(m.promotion()));
+    return s;
+}
@@ -0,0 +1,15 @@
+/* Perft: counts the leaf nodes of the legal move tree to a fixed depth.
+The counts are compared with published ones to check move generation,
+and nodes per second is the throughput figure for it.
+*/
+
+#ifndef PERFT_H
+#define PERFT_H
+
+#include "board.h"
+
+unsigned long long perft(chessboard& B, int depth);
+unsigned long long divide(chessboard& B, int depth, ostream& out);
+string move_name(Move m);
+
+#endif
@@ -0,0 +1,107 @@
+/* Perft benchmark: runs the standard perft positions, checks the node
+counts against the published ones and reports nodes per second.
+
+usage: perft_bench [max_depth] [file.epd]   (default 3)
+
+Each position is searched to max_depth, at least 1, or to the deepest count listed
+below if that is smaller. Exits with 1 if any count is wrong. An EPD
+file in the usual perft suite layout, "<fen> ;D1 20 ;D2 400 ...",
+replaces the positions below.
+*/
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include "board.h"
+#include "perft.h"
+#include "pgn.h"
+
+struct perft_position{
+    string name;
+    string_view fen;
+    vector<unsigned long long> nodes;   // nodes[d-1] is the count at depth d
+};
+
+const perft_position positions[]={
+    {"startpos", def,
+        {20, 400, 8902, 197281, 4865609, 119060324}},
+    {"kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        {48, 2039, 97862, 4085603, 193690690}},
+    {"en passant", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        {14, 191, 2812, 43238, 674624, 11030083, 178633661}},
+    {"promotion", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+        {6, 264, 9467, 422333, 15833292}},
+    {"promotion 2", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+        {44, 1486, 62379, 2103487, 89941194}},
+    {"middlegame", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+        {46, 2079, 89890, 3894594, 164075551}},
+};
+
+// One position per line; the FEN and the counts stay views into the file.
+static vector<perft_position> read_epd(string_view text){
+    vector<perft_position> list;
+    string_view line;
+    int number=0;
+    while(next_line(text, line)){
+        number++;
+        size_t semicolon=line.find(';');
+        perft_position p{"line "+to_string(number), line.substr(0, semicolon), {}};
+        while(semicolon!=string_view::npos){
+            line.remove_prefix(semicolon+1);
+            semicolon=line.find(';');
+            string_view op=line.substr(0, semicolon);
+            op.remove_prefix(min(op.find_first_not_of(' '), op.size()));
+            if(op.size()>2 && op[0]=='D' && isdigit(op[1]) && strtoul(op.data()+1, nullptr, 10)==p.nodes.size()+1)
+                p.nodes.push_back(strtoull(op.data()+op.find(' '), nullptr, 10));
+        }
+        if(!p.nodes.empty())
+            list.push_back(p);
+    }
+    return list;
+}
+
+int main(int argc, char* argv[]){
+    int max_depth=(argc>1 ? atoi(argv[1]) : 3);
+    mapped_file file(argc>2 ? argv[2] : "");
+    if(max_depth<1){
+        cout << "usage: perft_bench [max_depth] [file.epd]   (max_depth at least 1)" << endl;
+        return 1;
+    }
+    if(argc>2 && !file.is_open()){
+        cout << "cannot open " << argv[2] << endl;
+        return 1;
+    }
+    vector<perft_position> list(begin(positions), end(positions));
+    if(argc>2)
+        list=read_epd(file.view());
+    bool ok=true;
+    unsigned long long total=0;
+    double total_seconds=0;
+    for(const perft_position& p: list){
+        size_t depth=min<size_t>(max_depth, p.nodes.size());
+        chessboard B;
+        if(!B.setup(p.fen)){
+            cout << left << setw(12) << p.name << " invalid FEN" << endl;
+            ok=false;
+            continue;
+        }
+        auto start=chrono::steady_clock::now();
+        unsigned long long nodes=perft(B, depth);
+        double seconds=chrono::duration<double>(chrono::steady_clock::now()-start).count();
+        bool g=(nodes==p.nodes[depth-1]);
+        ok=ok && g;
+        total+=nodes;
+        total_seconds+=seconds;
+        cout << left << setw(12) << p.name << " depth " << depth
+             << right << setw(12) << nodes << " nodes"
+             << fixed << setprecision(3) << setw(10) << seconds << " s"
+             << setw(12) << (unsigned long long)(nodes/max(seconds, 1e-9)) << " nodes/s"
+             << (g ? "  ok" : "  WRONG, expected ");
+        if(!g)
+            cout << p.nodes[depth-1];
+        cout << endl;
+    }
+    cout << "total " << total << " nodes in " << total_seconds << " s, "
+         << (unsigned long long)(total/max(total_seconds, 1e-9)) << " nodes/s" << endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,319 @@
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <sstream>
+#include <thread>
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "history.h"
+#include "pgn.h"
+
+mapped_file:: mapped_file(const string& path, bool sequential){
+#ifdef __linux__
+    int fd=open(path.c_str(), O_RDONLY);
+    if(fd<0)
+        return;
+    struct stat st;
+    if(fstat(fd, &st)==0 && st.st_size>0){
+        void* p=mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(p!=MAP_FAILED){
+            madvise(p, st.st_size, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+            data=static_cast<char*>(p);
+            length=st.st_size;
+            mapped=true;
+        }
+    }
+    close(fd);
+    if(mapped)
+        return;
+#endif
+    FILE* f=fopen(path.c_str(), "rb");
+    if(f==nullptr)
+        return;
+    fseek(f, 0, SEEK_END);
+    long size=ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data=static_cast<char*>(malloc(max(size, 1L)));
+    length=(data ? fread(data, 1, size, f) : 0);
+    fclose(f);
+}
+
+mapped_file:: ~mapped_file(){
+#ifdef __linux__
+    if(mapped){
+        munmap(data, length);
+        return;
+    }
+#endif
+    free(data);
+}
+
+bool next_line(string_view& text, string_view& line){
+    if(text.empty())
+        return false;
+    size_t end=text.find('\n');
+    if(end==string_view::npos)
+        end=text.size()-1;
+    line=text.substr(0, end+1);
+    text.remove_prefix(end+1);
+    while(!line.empty() && (line.back()=='\n' || line.back()=='\r'))
+        line.remove_suffix(1);
+    return true;
+}
+
+static bool is_blank(string_view s){
+    return s.find_first_not_of(" \t\r\n")==string_view::npos;
+}
+
+bool next_game(string_view& text, string_view& game){
+    while(!text.empty()){
+        const char* start=text.data();
+        bool movetext=false;
+        string_view rest=text, line;
+        while(true){
+            string_view before=rest;
+            if(!next_line(rest, line))
+                break;
+            if(!line.empty() && line[0]=='[' && movetext){
+                rest=before;
+                break;
+            }
+            if(!line.empty() && line[0]!='[' && !is_blank(line))
+                movetext=true;
+        }
+        game=string_view(start, rest.data()-start);
+        text=rest;
+        if(!is_blank(game))
+            return true;
+    }
+    return false;
+}
+
+// Reads the tags and the movetext of one game. Comments, variations,
+// NAGs, move numbers and the result token are skipped.
+void parse_game(string_view text, pgn_game& g){
+    size_t i=0, n=text.size();
+    while(i<n){
+        char x=text[i];
+        if(x=='['){
+            size_t end=min(text.find(']', i), n);
+            string_view tag=text.substr(i+1, end-i-1);
+            size_t q1=tag.find('"'), q2=tag.rfind('"');
+            if(q1!=string_view::npos && q2>q1){
+                string_view name=tag.substr(0, tag.find(' '));
+                string_view value=tag.substr(q1+1, q2-q1-1);
+                if(name=="FEN")
+                    g.fen=value;
+                else if(name=="Result")
+                    g.result=value;
+            }
+            i=end+1;
+        }
+        else if(x=='{')
+            i=min(text.find('}', i), n)+1;
+        else if(x==';')
+            i=min(text.find('\n', i), n)+1;
+        else if(x=='('){
+            int depth=0;
+            for(; i<n; i++){
+                if(text[i]=='(')
+                    depth++;
+                else if(text[i]==')' && --depth==0)
+                    break;
+            }
+            i++;
+        }
+        else if(isspace(x))
+            i++;
+        else{
+            size_t start=i;
+            while(i<n && !isspace(text[i]) && text[i]!='{' && text[i]!='(' && text[i]!=';')
+                i++;
+            string_view token=text.substr(start, i-start);
+            // "12." and "12..." may be glued to the move that follows
+            size_t k=0;
+            while(k<token.size() && isdigit(token[k]))
+                k++;
+            if(k>0 && k<token.size() && token[k]=='.'){
+                while(k<token.size() && token[k]=='.')
+                    k++;
+                token.remove_prefix(k);
+            }
+            if(token.empty() || token[0]=='$' || token=="1-0" || token=="0-1" || token=="1/2-1/2" || token=="*")
+                continue;
+            if(isdigit(token[0]) && token!="0-0" && token!="0-0-0")
+                continue;
+            g.moves.push_back(token);
+        }
+    }
+}
+
+// Drops check signs and annotations, and accepts zeros in castling.
+string_view clean_san(string_view san){
+    while(!san.empty() && (san.back()=='+' || san.back()=='#' || san.back()=='!' || san.back()=='?'))
+        san.remove_suffix(1);
+    if(san=="0-0")
+        return "O-O";
+    if(san=="0-0-0")
+        return "O-O-O";
+    return san;
+}
+
+replay_result replay_game(const pgn_game& g){
+    replay_result r;
+    chessboard B;
+    game_history history;
+    if(!B.setup(g.fen)){
+        r.legal=false;
+        r.bad_fen=true;
+        return r;
+    }
+    for(size_t i=0; i<g.moves.size(); i++){
+        Move m;
+        r.error=read_san(clean_san(g.moves[i]), B, m, &history.legal);
+        if(r.error!=san_ok){
+            r.legal=false;
+            r.plies=i+1;
+            r.illegal_move=g.moves[i];
+            return r;
+        }
+        history.play(B, m);
+    }
+    r.plies=g.moves.size();
+    int x=check_state(B, &history.legal);
+    // A claimable draw, after fifty moves or threefold repetition, leaves
+    // the result to the players; fivefold repetition ends the game.
+    if(x==1)
+        r.board_result=(B.to_play==white ? "0-1" : "1-0");
+    else if(x<0 || history.repetitions(B)>=5)
+        r.board_result="1/2-1/2";
+    r.mismatch=(r.board_result!="*" && r.board_result!=g.result);
+    return r;
+}
+
+static void print_result(ostream& out, unsigned long long index, const pgn_game& g, const replay_result& r){
+    out << "game " << index+1 << ": ";
+    if(r.bad_fen)
+        out << "invalid FEN (" << g.fen << ")";
+    else if(!r.legal)
+        out << (r.error==san_ambiguous ? "ambiguous" : r.error==san_unknown ? "unreadable" : "illegal")
+            << " move at ply " << r.plies << " (" << r.illegal_move << ")";
+    else{
+        out << "legal, " << r.plies << " plies, " << g.result;
+        if(r.mismatch)
+            out << " but the board says " << r.board_result;
+    }
+    out << "\n";
+}
+
+// A game to replay: a view into the mapped file, or text of its own
+// when it comes from a stream.
+struct replay_job{
+    unsigned long long index;
+    string text;
+    string_view view;
+};
+
+// The calling thread feeds games from next_job, the workers replay them
+// and whichever worker completes the oldest outstanding game prints it
+// and any finished ones after it.
+template<class Source>
+static replay_summary run_replay(Source next_job, ostream& out, int threads){
+    threads=max(1, threads);
+    const unsigned long long window=64*threads;
+    mutex m;
+    condition_variable work_ready, window_free;
+    queue<replay_job> pending;
+    map<unsigned long long, pair<string, replay_result>> finished;
+    unsigned long long next_to_print=0;
+    bool end_of_input=false;
+    replay_summary summary;
+
+    auto worker=[&]{
+        pgn_game g;
+        ostringstream line;
+        while(true){
+            replay_job job;
+            {
+                unique_lock<mutex> lock(m);
+                work_ready.wait(lock, [&]{ return !pending.empty() || end_of_input; });
+                if(pending.empty())
+                    return;
+                job=std::move(pending.front());
+                pending.pop();
+            }
+            g=pgn_game();
+            parse_game(job.text.empty() ? job.view : string_view(job.text), g);
+            replay_result r=replay_game(g);
+            line.str("");
+            print_result(line, job.index, g, r);
+            unique_lock<mutex> lock(m);
+            finished[job.index]={line.str(), r};
+            while(!finished.empty() && finished.begin()->first==next_to_print){
+                auto& f=finished.begin()->second;
+                out << f.first;
+                summary.games++;
+                summary.plies+=f.second.plies;
+                summary.illegal+=!f.second.legal;
+                summary.mismatches+=f.second.mismatch;
+                finished.erase(finished.begin());
+                next_to_print++;
+            }
+            window_free.notify_one();
+        }
+    };
+    vector<thread> pool;
+    for(int i=0; i<threads; i++)
+        pool.emplace_back(worker);
+
+    unsigned long long index=0;
+    replay_job job;
+    while(next_job(job)){
+        unique_lock<mutex> lock(m);
+        window_free.wait(lock, [&]{ return index-next_to_print<window; });
+        job.index=index++;
+        pending.push(std::move(job));
+        work_ready.notify_one();
+        job=replay_job();
+    }
+    {
+        lock_guard<mutex> lock(m);
+        end_of_input=true;
+    }
+    work_ready.notify_all();
+    for(thread& t: pool)
+        t.join();
+    return summary;
+}
+
+replay_summary replay_pgn(string_view text, ostream& out, int threads){
+    return run_replay([&](replay_job& job){ return next_game(text, job.view); }, out, threads);
+}
+
+// Same cut as next_game, a line at a time.
+replay_summary replay_pgn(istream& in, ostream& out, int threads){
+    string line, carry;
+    return run_replay([&](replay_job& job){
+        bool movetext=false;
+        job.text=std::move(carry);
+        carry.clear();
+        while(getline(in, line)){
+            if(!line.empty() && line[0]=='[' && movetext){
+                carry=line+'\n';
+                return true;
+            }
+            if(!line.empty() && line[0]!='[' && !is_blank(line))
+                movetext=true;
+            job.text+=line;
+            job.text+='\n';
+        }
+        return !is_blank(job.text);
+    }, out, threads);
+}
@@ -0,0 +1,69 @@
+/* PGN replay: validates archived games by playing every move through
+understand_move, the parser the players use.
+
+Files are mapped into memory rather than read: a game is a string_view
+into the mapping, and so are its tags and moves, so nothing is copied
+or allocated per token. The chunks are independent, and a pool of
+workers replays each one on a board of its own. Standard input is
+streamed instead, one game at a time. Results are printed in input
+order, one line per game, and at most a fixed window of games is read
+ahead of the oldest unfinished one.
+*/
+
+#ifndef PGN_H
+#define PGN_H
+
+#include "board.h"
+
+// A file mapped read-only, or empty if it could not be opened. Pages are
+// read in ahead for a file read from start to end, and only on demand for
+// one that is probed here and there.
+class mapped_file{
+    char* data=nullptr;
+    size_t length=0;
+    bool mapped=false;         // else read into memory, off Linux
+public:
+    explicit mapped_file(const string& path, bool sequential=true);
+    mapped_file(const mapped_file&)=delete;
+    mapped_file& operator=(const mapped_file&)=delete;
+    ~mapped_file();
+    bool is_open() const {return data!=nullptr;}
+    string_view view() const {return string_view(data, length);}
+};
+
+// Cut off the first line, or the first game, of text: a game runs up to
+// the next tag line that follows some movetext. Both return false once
+// text is used up.
+bool next_line(string_view& text, string_view& line);
+bool next_game(string_view& text, string_view& game);
+
+struct pgn_game{
+    string_view fen=def;       // from a [FEN] tag, else the standard position
+    string_view result="*";    // from the [Result] tag
+    vector<string_view> moves; // SAN, without move numbers, comments or variations
+};
+
+struct replay_result{
+    bool legal=true;
+    bool bad_fen=false;        // the [FEN] tag is not a position; nothing played
+    san_error error=san_ok;    // why the move at ply was refused
+    int plies=0;               // moves played, or the ply of the refused one
+    string_view illegal_move;
+    string_view board_result="*";  // what the final position says: mate, a draw or *
+    bool mismatch=false;       // the board decides the game otherwise than the tag
+};
+
+struct replay_summary{
+    unsigned long long games=0;
+    unsigned long long illegal=0;
+    unsigned long long mismatches=0;
+    unsigned long long plies=0;
+};
+
+void parse_game(string_view text, pgn_game& g);
+string_view clean_san(string_view san);
+replay_result replay_game(const pgn_game& g);
+replay_summary replay_pgn(string_view text, ostream& out, int threads);
+replay_summary replay_pgn(istream& in, ostream& out, int threads);
+
+#endif
@@ -0,0 +1,296 @@
+#include <climits>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include "search.h"
+
+const int piece_value[6]={100, 320, 330, 500, 900, 0};
+
+// Mate scores are stored relative to the node, not to the root.
+static int score_to_tt(int score, int ply){
+    return score>mate_score-max_ply ? score+ply : score<-mate_score+max_ply ? score-ply : score;
+}
+
+static int score_from_tt(int score, int ply){
+    return score>mate_score-max_ply ? score-ply : score<-mate_score+max_ply ? score+ply : score;
+}
+
+search_result search(chessboard& B, const search_limits& limits, transposition_table& tt){
+    atomic<bool> s(false);
+    int n=max(1, limits.threads);
+    tt.new_search();
+    vector<unique_ptr<chessboard>> boards;
+    vector<unique_ptr<searcher>> searchers;
+    for(int i=0; i<n; i++){
+        boards.emplace_back(i==0 ? nullptr : new chessboard(B));
+        searchers.emplace_back(new searcher(i==0 ? B : *boards[i], tt, s, i));
+    }
+    vector<search_result> results(n);
+    vector<thread> helpers;
+    for(int i=1; i<n; i++)
+        helpers.emplace_back([&, i]{ results[i]=searchers[i]->run(limits); });
+    results[0]=searchers[0]->run(limits);
+    s=true;
+    for(thread& t: helpers)
+        t.join();
+
+    // The deepest result wins, then the best score; the nodes are every
+    // thread's.
+    search_result best=results[0];
+    for(int i=1; i<n; i++)
+        if(results[i].depth>best.depth || (results[i].depth==best.depth && results[i].score>best.score)){
+            best.best=results[i].best;
+            best.score=results[i].score;
+            best.depth=results[i].depth;
+        }
+    best.nodes=0;
+    best.thread_nodes.clear();
+    for(int i=0; i<n; i++){
+        best.nodes+=searchers[i]->nodes;
+        best.thread_nodes.push_back(searchers[i]->nodes);
+    }
+    return best;
+}
+
+search_result searcher:: run(const search_limits& limits){
+    this->limits=limits;
+    start=chrono::steady_clock::now();
+    nodes=0;
+    memset(killers, 0, sizeof(killers));
+    memset(history, 0, sizeof(history));
+    if(nnue_net)
+        accumulators.reset(B);
+    search_result result={Move(), 0, 0, 0, {}};
+    MoveList list;
+    legal_moves(B, list);
+    if(list.empty())
+        return result;
+    result.best=root_best=list[0];
+    for(int depth=1+(id%2); depth<=limits.depth; depth++){
+        int score=alpha_beta(-mate_score, mate_score, depth, 0, false);
+        if(stop && (depth>1 || id>0))
+            break;
+        result.best=root_best;
+        result.score=score;
+        result.depth=depth;
+        if(stop || score>mate_score-max_ply || score<-mate_score+max_ply)
+            break;
+    }
+    return result;
+}
+
+// Only the main searcher keeps the clock and counts against the node
+// budget; the helpers just follow the stop flag.
+bool searcher:: out_of_budget(){
+    if(id!=0)
+        return false;
+    if(limits.abort!=nullptr && limits.abort->load(memory_order_relaxed))
+        return true;
+    if(limits.nodes && nodes>=limits.nodes)
+        return true;
+    if(limits.milliseconds && (nodes & 1023)==0)
+        return chrono::steady_clock::now()-start>=chrono::milliseconds(limits.milliseconds);
+    return false;
+}
+
+// The board's make_move() and unmake_move(), with the network's
+// accumulators following along while one is loaded.
+void searcher:: make(Move m, Undo& u){
+    B.make_move(m, u);
+    if(nnue_net)
+        accumulators.push(B, u);
+}
+
+void searcher:: unmake(const Undo& u){
+    B.unmake_move(u);
+    if(nnue_net)
+        accumulators.pop();
+}
+
+int searcher:: eval(int alpha, int beta){
+    return nnue_net ? accumulators.evaluate(B) : evaluate(B, alpha, beta);
+}
+
+bool searcher:: is_capture(Move m){
+    return (B.all >> m.to() & 1) || m.kind()==move_en_passant;
+}
+
+// Scores every move and sorts, best first. An insertion sort keeps equal
+// scores in generation order without the buffer stable_sort allocates.
+void searcher:: order_moves(MoveList& list, uint16_t hash_move, int ply){
+    int scores[256];
+    for(int i=0; i<list.size(); i++){
+        Move m=list[i];
+        int score;
+        if(m.data==hash_move)
+            score=1 << 30;
+        else if(is_capture(m) || m.kind()==move_promotion){
+            Piece victim=B.at(m.to());
+            int v=(!victim.empty() ? piece_value[victim.type()] : piece_value[pawn]);
+            if(m.kind()==move_promotion)
+                v+=piece_value[m.promoted()];
+            score=(1 << 28)+16*v-B.at(m.from()).type();
+        }
+        else if(ply<max_ply && m.data==killers[ply][0])
+            score=(1 << 27)+1;
+        else if(ply<max_ply && m.data==killers[ply][1])
+            score=1 << 27;
+        else
+            score=history[m.from()][m.to()];
+        int j=i;
+        for(; j>0 && scores[j-1]<score; j--){
+            scores[j]=scores[j-1];
+            list[j]=list[j-1];
+        }
+        scores[j]=score;
+        list[j]=m;
+    }
+}
+
+int searcher:: alpha_beta(int alpha, int beta, int depth, int ply, bool null_allowed){
+    path[ply]=B.key;
+    if(ply>0){
+        for(int i=ply-2; i>=0; i-=2)
+            if(path[i]==B.key)
+                return 0;
+        if(ply>=max_ply)
+            return eval(INT_MIN, INT_MAX);
+    }
+    Color c=B.to_play;
+    bool in_check=B.is_square_attacked(B.returnPlayer(c).king, opponent(c));
+    if(in_check)
+        depth++;
+    if(depth<=0)
+        return quiescence(alpha, beta, ply);
+    nodes++;
+    if(out_of_budget())
+        stop=true;
+    if(stop.load(memory_order_relaxed))
+        return 0;
+
+    bool pv=(beta-alpha>1);
+    tt_data d;
+    uint16_t hash_move=0;
+    if(tt.probe(B.key, d)){
+        hash_move=d.move;
+        int score=score_from_tt(d.score, ply);
+        if(ply>0 && !pv && d.depth>=depth
+           && (d.bound==bound_exact || (d.bound==bound_lower && score>=beta) || (d.bound==bound_upper && score<=alpha)))
+            return score;
+    }
+
+    // Null move: if passing still fails high, a real move will too. Not
+    // tried without pieces, where passing can be the better move.
+    bitboard pieces=B.occupied[c] & ~B.pieces[c][pawn] & ~B.pieces[c][king];
+    if(null_allowed && !pv && !in_check && depth>=3 && pieces && eval(beta-1, beta)>=beta){
+        Undo u;
+        B.make_null_move(u);
+        if(nnue_net)
+            accumulators.push_null();
+        int score=-alpha_beta(-beta, -beta+1, depth-3, ply+1, false);
+        B.unmake_null_move(u);
+        if(nnue_net)
+            accumulators.pop();
+        if(stop.load(memory_order_relaxed))
+            return 0;
+        if(score>=beta)
+            return score>mate_score-max_ply ? beta : score;
+    }
+
+    MoveList list;
+    legal_moves(B, list);
+    if(list.empty())
+        return in_check ? -mate_score+ply : 0;
+    order_moves(list, hash_move, ply);
+
+    int best=-mate_score;
+    Move best_move=list[0];
+    int original_alpha=alpha;
+    for(int i=0; i<list.size(); i++){
+        Move m=list[i];
+        bool quiet=!is_capture(m) && m.kind()!=move_promotion;
+        Undo u;
+        make(m, u);
+        int score;
+        if(i==0)
+            score=-alpha_beta(-beta, -alpha, depth-1, ply+1, true);
+        else{
+            // Late quiet moves are searched one ply shallower first.
+            int reduction=(depth>=3 && i>=3 && quiet && !in_check ? 1+(i>=8) : 0);
+            score=-alpha_beta(-alpha-1, -alpha, depth-1-reduction, ply+1, true);
+            if(score>alpha && reduction)
+                score=-alpha_beta(-alpha-1, -alpha, depth-1, ply+1, true);
+            if(score>alpha && score<beta)
+                score=-alpha_beta(-beta, -alpha, depth-1, ply+1, true);
+        }
+        unmake(u);
+        if(stop.load(memory_order_relaxed))
+            return 0;
+        if(score>best){
+            best=score;
+            best_move=m;
+            if(ply==0)
+                root_best=m;
+        }
+        if(score>alpha)
+            alpha=score;
+        if(alpha>=beta){
+            if(quiet){
+                if(killers[ply][0]!=m.data){
+                    killers[ply][1]=killers[ply][0];
+                    killers[ply][0]=m.data;
+                }
+                history[m.from()][m.to()]+=depth*depth;
+            }
+            break;
+        }
+    }
+    Bound bound=(best>=beta ? bound_lower : best>original_alpha ? bound_exact : bound_upper);
+    tt.store(B.key, best_move.data, score_to_tt(best, ply), depth, bound);
+    return best;
+}
+
+// Only captures and promotions, until the position is quiet. In check
+// every evasion is searched, since standing pat is not an option then.
+int searcher:: quiescence(int alpha, int beta, int ply){
+    nodes++;
+    if(out_of_budget())
+        stop=true;
+    if(stop.load(memory_order_relaxed))
+        return 0;
+    if(ply>=max_ply)
+        return eval(INT_MIN, INT_MAX);
+    Color c=B.to_play;
+    bool in_check=B.is_square_attacked(B.returnPlayer(c).king, opponent(c));
+    int best=-mate_score+ply;
+    if(!in_check){
+        best=eval(alpha, beta);
+        if(best>=beta)
+            return best;
+        if(best>alpha)
+            alpha=best;
+    }
+    MoveList list;
+    legal_moves(B, list);
+    if(list.empty())
+        return in_check ? -mate_score+ply : 0;
+    order_moves(list, 0, max_ply);
+    for(int i=0; i<list.size(); i++){
+        Move m=list[i];
+        if(!in_check && !is_capture(m) && m.kind()!=move_promotion)
+            break;
+        Undo u;
+        make(m, u);
+        int score=-quiescence(-beta, -alpha, ply+1);
+        unmake(u);
+        if(stop.load(memory_order_relaxed))
+            return 0;
+        if(score>best)
+            best=score;
+        if(score>alpha)
+            alpha=score;
+        if(alpha>=beta)
+            break;
+    }
+    return best;
+}
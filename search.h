@@ -0,0 +1,79 @@
+/* Alpha-beta search, for hints and the computer opponent.
+
+Iterative deepening with a principal variation search and a quiescence
+search over captures. Moves are ordered by the hash move, then captures
+by MVV-LVA (most valuable victim, least valuable attacker), then killer
+moves and the history table. Null-move pruning and late move reductions
+cut the tree. The legal moves, make_move() and check detection all come
+from the board, so the search plays by the same rules as the players.
+A search stops at a depth, node or time budget, whichever is hit first.
+
+With threads=N it is a Lazy SMP search: N searchers run the same root on
+their own copies of the board, sharing only the hash table and a stop
+flag. Helpers start at alternating depths so they fill the table with
+different subtrees, and the deepest completed result wins. The main
+searcher watches the budget and raises the stop flag for everyone.
+*/
+
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <atomic>
+#include <chrono>
+#include "board.h"
+#include "eval.h"
+#include "nnue.h"
+#include "tt.h"
+
+const int mate_score=32000;
+const int max_ply=100;
+
+struct search_limits{
+    int depth=max_ply-1;
+    unsigned long long nodes=0;    // 0 for no limit
+    int milliseconds=0;            // 0 for no limit
+    int threads=1;
+    int max_threads=0;             // the most "threads=" may ask for, 0 for no limit
+    const atomic<bool>* abort=nullptr;   // lets another thread end the search early
+};
+
+struct search_result{
+    Move best;
+    int score;                     // centipawns for the side to play
+    int depth;                     // last iteration that was completed
+    unsigned long long nodes;      // all threads
+    vector<unsigned long long> thread_nodes;
+};
+
+class searcher{
+public:
+    searcher(chessboard& B, transposition_table& tt, atomic<bool>& stop, int id): B(B), tt(tt), stop(stop), id(id), accumulators(max_ply) {}
+    search_result run(const search_limits& limits);
+    unsigned long long nodes=0;
+
+private:
+    int alpha_beta(int alpha, int beta, int depth, int ply, bool null_allowed);
+    int quiescence(int alpha, int beta, int ply);
+    void order_moves(MoveList& list, uint16_t hash_move, int ply);
+    bool is_capture(Move m);
+    bool out_of_budget();
+    void make(Move m, Undo& u);
+    void unmake(const Undo& u);
+    int eval(int alpha, int beta);
+
+    chessboard& B;
+    transposition_table& tt;
+    atomic<bool>& stop;
+    int id;                        // 0 is the main searcher
+    search_limits limits;
+    chrono::steady_clock::time_point start;
+    Move root_best;
+    bitboard path[max_ply+1];      // keys on the way down, for repetitions
+    nnue_stack accumulators;       // the network's, ply by ply, while one is loaded
+    uint16_t killers[max_ply][2];
+    int history[64][64];
+};
+
+search_result search(chessboard& B, const search_limits& limits, transposition_table& tt);
+
+#endif
@@ -0,0 +1,335 @@
+#include <atomic>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <sstream>
+#include <thread>
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+#include "history.h"
+#include "server.h"
+
+#ifdef __linux__
+
+struct session{
+    int fd;
+    chessboard B;
+    game_history history;
+    search_limits limits;
+    string input;              // the start of a line still being received
+    uint32_t watched=EPOLLIN;  // the epoll events asked for
+    bool hung_up=false;        // the client sent all it will send
+    // the rest is shared with the workers
+    mutex m;
+    deque<string> commands;
+    string output;
+    bool busy=false;           // queued for or held by a worker
+    bool over=false;
+};
+
+// A client that sends a line longer than this, or gets further ahead
+// of its game than this many commands, is disconnected rather than
+// buffered without end.
+const size_t max_line=4096;
+const size_t max_queued=1024;
+
+static volatile sig_atomic_t interrupted=0;
+
+static void on_interrupt(int){
+    interrupted=1;
+}
+
+// A port number listens on TCP, anything else is a Unix socket path.
+static int open_listener(const string& address){
+    int fd;
+    if(!address.empty() && address.find_first_not_of("0123456789")==string::npos){
+        fd=socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        int one=1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in a={};
+        a.sin_family=AF_INET;
+        a.sin_port=htons(stoi(address));
+        a.sin_addr.s_addr=htonl(INADDR_LOOPBACK);
+        if(fd<0 || bind(fd, (sockaddr*)&a, sizeof(a))<0 || listen(fd, SOMAXCONN)<0)
+            return -1;
+    }
+    else{
+        fd=socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        sockaddr_un a={};
+        a.sun_family=AF_UNIX;
+        if(address.size()>=sizeof(a.sun_path))
+            return -1;
+        strcpy(a.sun_path, address.c_str());
+        unlink(address.c_str());
+        if(fd<0 || bind(fd, (sockaddr*)&a, sizeof(a))<0 || listen(fd, SOMAXCONN)<0)
+            return -1;
+    }
+    return fd;
+}
+
+int serve(const string& address, int workers, const search_limits& limits){
+    int listener=open_listener(address);
+    if(listener<0){
+        cout << "cannot listen on " << address << ": " << strerror(errno) << endl;
+        return 1;
+    }
+    struct sigaction sa={};
+    sa.sa_handler=on_interrupt;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+    int epfd=epoll_create1(0);
+    int wake=eventfd(0, EFD_NONBLOCK);
+    epoll_event ev={};
+    ev.events=EPOLLIN;
+    ev.data.fd=listener;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, listener, &ev);
+    ev.data.fd=wake;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, wake, &ev);
+
+    map<int, shared_ptr<session>> sessions;
+    mutex m;                   // guards ready, replied and stopping
+    condition_variable work_ready;
+    queue<shared_ptr<session>> ready;
+    vector<int> replied;       // sessions with new output, for the epoll thread
+    bool stopping=false;
+
+    // One command of one session per turn; the session goes to the back
+    // of the queue if it has more.
+    auto worker=[&]{
+        while(true){
+            shared_ptr<session> s;
+            {
+                unique_lock<mutex> lock(m);
+                work_ready.wait(lock, [&]{ return !ready.empty() || stopping; });
+                if(ready.empty())
+                    return;
+                s=ready.front();
+                ready.pop();
+            }
+            string c;
+            {
+                lock_guard<mutex> lock(s->m);
+                c=s->commands.front();
+                s->commands.pop_front();
+            }
+            ostringstream out;
+            bool over=s->B.command(c, out, true, s->history, s->limits);
+            if(!over)
+                out << "> ";
+            bool again;
+            {
+                lock_guard<mutex> lock(s->m);
+                s->output+=out.str();
+                s->over=over;
+                if(over)
+                    s->commands.clear();
+                again=!s->commands.empty();
+                s->busy=again;
+            }
+            {
+                lock_guard<mutex> lock(m);
+                if(again){
+                    ready.push(s);
+                    work_ready.notify_one();
+                }
+                replied.push_back(s->fd);
+            }
+            uint64_t one=1;
+            if(write(wake, &one, sizeof(one))<0){}
+        }
+    };
+    vector<thread> pool;
+    for(int i=0; i<max(1, workers); i++)
+        pool.emplace_back(worker);
+
+    auto close_session=[&](int fd){
+        epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        sessions.erase(fd);
+    };
+    // Sends what the socket takes now and waits for EPOLLOUT for the rest.
+    // The connection closes once everything is sent and the game is over,
+    // or the client has hung up and its last commands are answered.
+    auto flush=[&](shared_ptr<session> s){
+        bool done, finished, failed=false;
+        {
+            lock_guard<mutex> lock(s->m);
+            while(!s->output.empty()){
+                ssize_t n=send(s->fd, s->output.data(), s->output.size(), MSG_NOSIGNAL);
+                if(n<0 && errno!=EAGAIN && errno!=EWOULDBLOCK)
+                    failed=true;
+                if(n<=0)
+                    break;
+                s->output.erase(0, n);
+            }
+            done=s->output.empty();
+            finished=done && (s->over || (s->hung_up && !s->busy));
+        }
+        if(failed || finished){
+            close_session(s->fd);
+            return;
+        }
+        uint32_t events=(s->hung_up ? 0u : uint32_t(EPOLLIN)) | (done ? 0u : uint32_t(EPOLLOUT));
+        if(events!=s->watched){
+            s->watched=events;
+            epoll_event e={};
+            e.events=events;
+            e.data.fd=s->fd;
+            epoll_ctl(epfd, EPOLL_CTL_MOD, s->fd, &e);
+        }
+    };
+
+    // Queues the whole lines received so far: a command may arrive in
+    // pieces. False if the session went over max_line or max_queued.
+    auto take_lines=[&](const shared_ptr<session>& s){
+        size_t end=s->input.rfind('\n');
+        if(end==string::npos)
+            return s->input.size()<=max_line;
+        istringstream lines(s->input.substr(0, end));
+        s->input.erase(0, end+1);
+        bool ok=(s->input.size()<=max_line), schedule=false;
+        string line, c;
+        {
+            lock_guard<mutex> lock(s->m);
+            while(getline(lines, line)){
+                ok=ok && line.size()<=max_line;
+                istringstream words(line);
+                while(words >> c)
+                    if(!s->over)
+                        s->commands.push_back(c);
+            }
+            ok=ok && s->commands.size()<=max_queued;
+            if(!ok){
+                s->commands.clear();
+                s->over=true;
+            }
+            else if(!s->commands.empty() && !s->busy)
+                schedule=s->busy=true;
+        }
+        if(schedule){
+            lock_guard<mutex> lock(m);
+            ready.push(s);
+            work_ready.notify_one();
+        }
+        return ok;
+    };
+
+    cout << "serving on " << address << " with " << pool.size() << " workers" << endl;
+    epoll_event events[64];
+    while(!interrupted){
+        int n=epoll_wait(epfd, events, 64, -1);
+        for(int i=0; i<n; i++){
+            int fd=events[i].data.fd;
+            if(fd==listener){
+                int c;
+                while((c=accept4(listener, nullptr, nullptr, SOCK_NONBLOCK))>=0){
+                    auto s=make_shared<session>();
+                    s->fd=c;
+                    s->B.setup();
+                    s->limits=limits;
+                    ostringstream out;
+                    out << s->B << "> ";
+                    s->output=out.str();
+                    sessions[c]=s;
+                    epoll_event e={};
+                    e.events=EPOLLIN;
+                    e.data.fd=c;
+                    epoll_ctl(epfd, EPOLL_CTL_ADD, c, &e);
+                    flush(s);
+                }
+            }
+            else if(fd==wake){
+                uint64_t count;
+                if(read(wake, &count, sizeof(count))<0){}
+                vector<int> fds;
+                {
+                    lock_guard<mutex> lock(m);
+                    fds.swap(replied);
+                }
+                for(int f: fds){
+                    auto it=sessions.find(f);
+                    if(it!=sessions.end())
+                        flush(it->second);
+                }
+            }
+            else{
+                auto it=sessions.find(fd);
+                if(it==sessions.end())
+                    continue;
+                shared_ptr<session> s=it->second;
+                if(events[i].events & (EPOLLHUP | EPOLLERR)){
+                    close_session(fd);
+                    continue;
+                }
+                if(!(events[i].events & EPOLLIN)){
+                    flush(s);
+                    continue;
+                }
+                char buffer[4096];
+                ssize_t k;
+                bool flooded=false;
+                while(!flooded && (k=recv(fd, buffer, sizeof(buffer), 0))>0){
+                    s->input.append(buffer, k);
+                    flooded=!take_lines(s);
+                }
+                if(flooded){
+                    const char notice[]="too much input, closing the session\n";
+                    if(send(fd, notice, sizeof(notice)-1, MSG_NOSIGNAL | MSG_DONTWAIT)<0){}
+                    close_session(fd);
+                    continue;
+                }
+                if(k<0 && errno!=EAGAIN && errno!=EWOULDBLOCK){
+                    close_session(fd);
+                    continue;
+                }
+                if(k==0){
+                    s->hung_up=true;
+                    s->input+='\n';
+                    take_lines(s);
+                }
+                flush(s);
+            }
+        }
+    }
+
+    {
+        lock_guard<mutex> lock(m);
+        stopping=true;
+        while(!ready.empty())
+            ready.pop();
+    }
+    work_ready.notify_all();
+    for(thread& t: pool)
+        t.join();
+    while(!sessions.empty())
+        close_session(sessions.begin()->first);
+    close(listener);
+    close(wake);
+    close(epfd);
+    if(address.find_first_not_of("0123456789")!=string::npos)
+        unlink(address.c_str());
+    cout << "server stopped" << endl;
+    return 0;
+}
+
+#else
+
+int serve(const string& address, int workers, const search_limits& limits){
+    cout << "the server needs Linux (epoll)" << endl;
+    return 1;
+}
+
+#endif
@@ -0,0 +1,27 @@
+/* Game server: many blindfold games in one process, each connection a
+game of its own with its own board and history.
+
+The calling thread waits on every socket with epoll and splits what
+arrives into commands; a small pool of workers plays them. A session is
+served by one worker at a time, one command per turn, so a busy player
+cannot hold a worker up. Replies are rendered with operator<< into the
+session's buffer and sent by the epoll thread as the socket takes them.
+The game ends the connection when it ends, and so does a client that
+sends overlong lines or many more commands than have been answered.
+Sessions always search with one thread, whatever "threads=" asks.
+
+The address is a port on 127.0.0.1 or the path of a Unix socket. Any
+line-based client works, e.g. printf 'e4\nresign\n' | nc localhost 4000;
+tools/server_client.py plays many sessions at once and checks each ends.
+*/
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "board.h"
+#include "search.h"
+
+// Runs until interrupted; the exit status for main().
+int serve(const string& address, int workers, const search_limits& limits);
+
+#endif
@@ -0,0 +1,706 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "tablebase.h"
+
+// Materials are written with uppercase letters, the stronger side first
+// and each side's pieces strongest first: "KQKR" is king and queen
+// against king and rook.
+static const char piece_letters[]="PNBRQK";
+static const int piece_values[]={1, 3, 3, 5, 9, 0};
+
+// Stored values: 0 a draw, odd p a win in p plies, even p+2 a loss in p
+// plies. While a table is made, invalid marks positions that are
+// illegal or not the kept one of their symmetric set, and exit_draw a
+// capture or promotion that draws.
+static int win_code(int plies){return plies;}
+static int loss_code(int plies){return plies+2;}
+static int plies_of(int code){return code%2 ? code : code-2;}
+const uint8_t invalid=255;
+const uint8_t exit_draw=255;
+
+// Higher is better for the side to play: fast wins, then draws, then
+// slow losses.
+static int preference(int code){
+    if(code==0 || code==exit_draw)
+        return 0;
+    return code%2 ? 1000-code : code-1000;
+}
+
+// The pieces of a table in the order of its index: the two kings, then
+// white's other pieces and black's, white being the stronger side.
+struct tb_layout{
+    string name;
+    int n=0;
+    PieceType type[4];
+    Color color[4];
+    bool pawns=false;
+    uint64_t per_side=0;    // positions with one side to play
+};
+
+// Whether a side with pieces a, besides its king, is at least as strong
+// as one with pieces b. Both are sorted strongest first.
+static bool stronger(const PieceType* a, int na, const PieceType* b, int nb){
+    int va=0, vb=0;
+    for(int i=0; i<na; i++)
+        va+=piece_values[a[i]];
+    for(int i=0; i<nb; i++)
+        vb+=piece_values[b[i]];
+    if(va!=vb)
+        return va>vb;
+    return !lexicographical_compare(b, b+nb, a, a+na, [](PieceType x, PieceType y){return x>y;});
+}
+
+static tb_layout layout_of(const PieceType extra[2][2], const int count[2]){
+    tb_layout L;
+    L.type[0]=L.type[1]=king;
+    L.color[0]=white;
+    L.color[1]=black;
+    L.n=2;
+    for(int c=0; c<2; c++){
+        L.name+='K';
+        for(int i=0; i<count[c]; i++){
+            L.name+=piece_letters[extra[c][i]];
+            L.type[L.n]=extra[c][i];
+            L.color[L.n++]=Color(c);
+            L.pawns|=(extra[c][i]==pawn);
+        }
+    }
+    L.per_side=(L.pawns ? 32 : 10);
+    for(int k=1; k<L.n; k++)
+        L.per_side*=64;
+    return L;
+}
+
+static tb_layout layout_of(const string& name){
+    PieceType extra[2][2];
+    int count[2]={0, 0}, c=-1;
+    for(char x : name){
+        if(x=='K')
+            c++;
+        else
+            extra[c][count[c]++]=PieceType(strchr(piece_letters, x)-piece_letters);
+    }
+    return layout_of(extra, count);
+}
+
+// The ten squares of the a1-d1-d4 triangle, and the number of each
+// square in it, -1 outside.
+static int triangle_square[10];
+static int triangle_index[64];
+static bool triangle_ready=[]{
+    fill(triangle_index, triangle_index+64, -1);
+    int k=0;
+    for(int rank=0; rank<4; rank++)
+        for(int file=rank; file<4; file++){
+            triangle_square[k]=8*rank+file;
+            triangle_index[8*rank+file]=k++;
+        }
+    return true;
+}();
+
+static int transpose(int s){
+    return (s & 7) << 3 | s >> 3;
+}
+
+static uint64_t raw_index(const tb_layout& L, const int* sq){
+    uint64_t i=(L.pawns ? (sq[0] >> 3)*4+(sq[0] & 7) : triangle_index[sq[0]]);
+    for(int k=1; k<L.n; k++)
+        i=i*64+sq[k];
+    return i;
+}
+
+// With four pieces only the last two can be alike.
+static void sort_alike(const tb_layout& L, int* sq){
+    if(L.n==4 && L.type[3]==L.type[2] && L.color[3]==L.color[2] && sq[3]<sq[2])
+        swap(sq[2], sq[3]);
+}
+
+// Moves the squares to the kept position of their symmetric set and
+// returns its index. A white king on the a1-d4 diagonal leaves two
+// candidates, its position and the one mirrored in that diagonal; the
+// lower index is kept.
+static uint64_t index_of(const tb_layout& L, int* sq){
+    if((sq[0] & 7)>3)
+        for(int k=0; k<L.n; k++)
+            sq[k]^=7;
+    if(!L.pawns){
+        if((sq[0] >> 3)>3)
+            for(int k=0; k<L.n; k++)
+                sq[k]^=56;
+        int file=sq[0] & 7, rank=sq[0] >> 3;
+        if(rank>file)
+            for(int k=0; k<L.n; k++)
+                sq[k]=transpose(sq[k]);
+        else if(rank==file){
+            int t[4]={};
+            for(int k=0; k<L.n; k++)
+                t[k]=transpose(sq[k]);
+            sort_alike(L, sq);
+            sort_alike(L, t);
+            uint64_t a=raw_index(L, sq), b=raw_index(L, t);
+            if(b<a){
+                copy(t, t+L.n, sq);
+                return b;
+            }
+            return a;
+        }
+    }
+    sort_alike(L, sq);
+    return raw_index(L, sq);
+}
+
+static void squares_of(const tb_layout& L, uint64_t i, int* sq){
+    for(int k=L.n-1; k>0; k--){
+        sq[k]=i%64;
+        i/=64;
+    }
+    sq[0]=(L.pawns ? (i/4)*8+i%4 : triangle_square[i]);
+}
+
+// Whether the index is a position at all, with no two pieces on a square
+// and no pawn on the first or last rank, and the kept one of its set.
+static bool valid_squares(const tb_layout& L, uint64_t i, int* sq){
+    squares_of(L, i, sq);
+    bitboard all=0;
+    for(int k=0; k<L.n; k++){
+        if(all >> sq[k] & 1)
+            return false;
+        if(L.type[k]==pawn && (sq[k] < 8 || sq[k]>=56))
+            return false;
+        all|=1ULL << sq[k];
+    }
+    int t[4]={};
+    copy(sq, sq+L.n, t);
+    return index_of(L, t)==i;
+}
+
+// The squares left and right of s.
+static bitboard beside(int s){
+    return (s%8>0 ? 1ULL << (s-1) : 0) | (s%8<7 ? 1ULL << (s+1) : 0);
+}
+
+// Calls f with the entry of every position, with the other side to play,
+// from which a move that is neither a capture nor a promotion leads to
+// entry e. A double step next to a pawn of the other side is left out:
+// it leads to the position with an en passant right, which the table
+// does not hold, and generate_table() counts it as an exit instead.
+template<class F> static void for_each_predecessor(const tb_layout& L, uint64_t e, F f){
+    Color mover=opponent(Color(e/L.per_side));
+    int sq[4];
+    squares_of(L, e%L.per_side, sq);
+    bitboard all=0, their_pawns=0;
+    for(int k=0; k<L.n; k++){
+        all|=1ULL << sq[k];
+        if(L.type[k]==pawn && L.color[k]!=mover)
+            their_pawns|=1ULL << sq[k];
+    }
+    for(int k=0; k<L.n; k++){
+        if(L.color[k]!=mover)
+            continue;
+        int y=sq[k];
+        bitboard from=0;
+        switch(L.type[k]){
+            case knight: from=attacks.knight[y]; break;
+            case bishop: from=bishop_attacks(y, all); break;
+            case rook: from=rook_attacks(y, all); break;
+            case queen: from=rook_attacks(y, all) | bishop_attacks(y, all); break;
+            case king: from=attacks.king[y]; break;
+            case pawn:{
+                // one square back, or two from the fourth rank
+                int back=(mover==white ? -8 : 8), x=y+back;
+                if(x>=8 && x<56 && !(all >> x & 1)){
+                    from|=1ULL << x;
+                    if((y >> 3)==(mover==white ? 3 : 4) && !(all >> (x+back) & 1) && !(beside(y) & their_pawns))
+                        from|=1ULL << (x+back);
+                }
+                break;
+            }
+        }
+        from&=~all;
+        while(from){
+            int t[4]={};
+            copy(sq, sq+L.n, t);
+            t[k]=pop_lsb(from);
+            f(uint64_t(mover)*L.per_side+index_of(L, t));
+        }
+    }
+}
+
+// Runs f(first, last) over [0, n) in chunks taken by threads threads.
+static void parallel_for(uint64_t n, int threads, const function<void(uint64_t, uint64_t)>& f){
+    const uint64_t chunk=1 << 14;
+    atomic<uint64_t> next{0};
+    auto work=[&]{
+        while(true){
+            uint64_t first=next.fetch_add(chunk);
+            if(first>=n)
+                return;
+            f(first, min(n, first+chunk));
+        }
+    };
+    vector<thread> pool;
+    for(int i=1; i<threads; i++)
+        pool.emplace_back(work);
+    work();
+    for(thread& t : pool)
+        t.join();
+}
+
+static void raise_to(atomic<int>& a, int v){
+    int x=a.load();
+    while(x<v && !a.compare_exchange_weak(x, v));
+}
+
+tablebase:: tablebase(const string& dir): dir(dir){
+    error_code ec;
+    for(const auto& f : filesystem::directory_iterator(dir, ec))
+        if(f.path().extension()==".ctb")
+            load(f.path().stem().string());
+}
+
+// A file is a 16-byte header, "ctb1", the bits per position, and the
+// number of positions as a little-endian 64-bit number at byte 8, then
+// the values packed from the lowest bit of each byte up.
+bool tablebase:: load(const string& material){
+    auto t=make_unique<table>(dir+"/"+material+".ctb");
+    string_view v=t->file.view();
+    if(v.size()<16 || v.substr(0, 4)!="ctb1")
+        return false;
+    t->bits=v[4];
+    t->entries=0;
+    for(int i=7; i>=0; i--)
+        t->entries=t->entries << 8 | (unsigned char)v[8+i];
+    if(t->bits<1 || t->bits>8 || v.size()<16+(t->entries*t->bits+7)/8+1)
+        return false;
+    tables[material]=std::move(t);
+    return true;
+}
+
+tb_result tablebase:: probe(chessboard& B) const{
+    tb_result r;
+    if(__builtin_popcountll(B.all)>4 || B.castling_key())
+        return r;
+    if(B.en_passant_key())
+        return probe_moves(B);
+    PieceType extra[2][2]={{pawn, pawn}, {pawn, pawn}};
+    int sq[2][2], count[2]={0, 0};
+    for(int c=0; c<2; c++)
+        for(int t=queen; t>=pawn; t--){
+            bitboard b=B.pieces[c][t];
+            while(b){
+                if(count[c]==2)
+                    return r;
+                sq[c][count[c]]=pop_lsb(b);
+                extra[c][count[c]++]=PieceType(t);
+            }
+        }
+    if(count[white]+count[black]==0){
+        r.found=true;
+        return r;
+    }
+    // Look it up with the stronger side as white.
+    Color strong=(stronger(extra[white], count[white], extra[black], count[black]) ? white : black);
+    Color weak=opponent(strong);
+    int flip=(strong==white ? 0 : 56);
+    PieceType e[2][2]={{extra[strong][0], extra[strong][1]}, {extra[weak][0], extra[weak][1]}};
+    int n[2]={count[strong], count[weak]};
+    tb_layout L=layout_of(e, n);
+    auto it=tables.find(L.name);
+    if(it==tables.end())
+        return r;
+    int s[4]={__builtin_ctzll(B.pieces[strong][king])^flip, __builtin_ctzll(B.pieces[weak][king])^flip};
+    for(int i=0; i<n[0]; i++)
+        s[2+i]=sq[strong][i]^flip;
+    for(int i=0; i<n[1]; i++)
+        s[2+n[0]+i]=sq[weak][i]^flip;
+    uint64_t index=(B.to_play==strong ? 0 : L.per_side)+index_of(L, s);
+    const table& t=*it->second;
+    if(index>=t.entries)
+        return r;
+    const unsigned char* data=reinterpret_cast<const unsigned char*>(t.file.view().data())+16;
+    uint64_t bit=index*t.bits;
+    unsigned w=data[bit >> 3] | data[(bit >> 3)+1] << 8;
+    int code=w >> (bit & 7) & ((1 << t.bits)-1);
+    r.found=true;
+    if(code){
+        r.wdl=(code%2 ? 1 : -1);
+        r.plies=plies_of(code);
+    }
+    return r;
+}
+
+// A position the tables do not hold, one with an en passant right, is
+// worth its best move: every position after one is in them.
+tb_result tablebase:: probe_moves(chessboard& B) const{
+    tb_result r;
+    MoveList list;
+    legal_moves(B, list);
+    int best=-1;
+    for(Move m : list){
+        Undo u;
+        B.make_move(m, u);
+        tb_result after=probe(B);
+        B.unmake_move(u);
+        if(!after.found)
+            return r;
+        int code=(after.wdl<0 ? win_code(after.plies+1) : after.wdl>0 ? loss_code(after.plies+1) : 0);
+        if(best<0 || preference(code)>preference(best))
+            best=code;
+    }
+    if(best<0)
+        best=(B.is_square_attacked(B.returnPlayer(B.to_play).king, opponent(B.to_play)) ? loss_code(0) : 0);
+    r.found=true;
+    if(best){
+        r.wdl=(best%2 ? 1 : -1);
+        r.plies=plies_of(best);
+    }
+    return r;
+}
+
+Move tablebase:: best_move(chessboard& B) const{
+    if(!probe(B).found)
+        return Move();
+    MoveList list;
+    legal_moves(B, list);
+    Move best=Move();
+    int score=-100000;
+    for(Move m : list){
+        Undo u;
+        B.make_move(m, u);
+        tb_result r=probe(B);
+        B.unmake_move(u);
+        if(!r.found)
+            continue;
+        int code=(r.wdl<0 ? win_code(r.plies+1) : r.wdl>0 ? loss_code(r.plies+1) : 0);
+        if(preference(code)>score){
+            score=preference(code);
+            best=m;
+        }
+    }
+    return best;
+}
+
+// A double step a pawn of the other side could answer en passant, from
+// entry from to entry to, the same position without the right. capture
+// is the best en passant capture for the side taking, kept as the exits
+// are, 0 if none is legal; others tells whether that side has other
+// moves.
+struct double_step{
+    uint64_t from, to;
+    uint8_t capture;
+    bool others;
+};
+
+// What the position after the double step is worth to the side to play,
+// from what it is worth without the en passant right.
+static int after_double_step(const double_step& d, int without){
+    if(d.capture==0)
+        return without;
+    int taking=(d.capture==exit_draw ? 0 : d.capture);
+    return !d.others || preference(taking)>preference(without) ? taking : without;
+}
+
+// Makes one table from the ones before it, which tb has mapped.
+static bool generate_table(const tablebase& tb, const tb_layout& L, const string& path, int threads, ostream& out){
+    auto start=chrono::steady_clock::now();
+    uint64_t total=2*L.per_side;
+    unique_ptr<atomic<uint8_t>[]> value(new atomic<uint8_t>[total]);
+    unique_ptr<atomic<uint8_t>[]> count(new atomic<uint8_t>[total]);
+    vector<uint8_t> exit(total);
+    atomic<bool> missing{false};
+    vector<double_step> steps;
+    mutex steps_lock;
+
+    // Which positions are legal, which are mate, and the best capture or
+    // promotion, looked up in the smaller tables; and the double steps
+    // that allow en passant, with the captures looked up too.
+    parallel_for(total, threads, [&](uint64_t first, uint64_t last){
+        vector<double_step> found;
+        chessboard B;
+        B.setup("4k3/8/8/8/8/8/8/4K3 w - - 0 1");
+        B.remove({'e', 1});
+        B.remove({'e', 8});
+        int placed[4], n=0;
+        for(uint64_t e=first; e<last; e++){
+            count[e].store(0, memory_order_relaxed);
+            exit[e]=0;
+            Color side=Color(e/L.per_side);
+            int sq[4];
+            if(!valid_squares(L, e%L.per_side, sq)){
+                value[e].store(invalid, memory_order_relaxed);
+                continue;
+            }
+            for(int k=0; k<n; k++)
+                B.remove(square_position(placed[k]));
+            for(int k=0; k<L.n; k++)
+                B.place(Piece(L.type[k], L.color[k]), square_position(placed[k]=sq[k]));
+            n=L.n;
+            B.white_player.king=square_position(sq[0]);
+            B.black_player.king=square_position(sq[1]);
+            if(B.to_play!=side){
+                B.to_play=side;
+                B.key^=zobrist.side;
+            }
+            if(B.is_square_attacked(B.returnPlayer(opponent(side)).king, side)){
+                value[e].store(invalid, memory_order_relaxed);
+                continue;
+            }
+            MoveList list;
+            legal_moves(B, list);
+            if(list.empty()){
+                bool check=B.is_square_attacked(B.returnPlayer(side).king, opponent(side));
+                value[e].store(check ? loss_code(0) : 0, memory_order_relaxed);
+                continue;
+            }
+            int best=0;
+            for(Move m : list){
+                if(B.at(m.from()).type()==pawn && abs(m.to()-m.from())==16 && (beside(m.to()) & B.pieces[opponent(side)][pawn])){
+                    double_step d{e, 0, 0, false};
+                    int t[4]={};
+                    for(int k=0; k<L.n; k++)
+                        t[k]=(sq[k]==m.from() ? m.to() : sq[k]);
+                    d.to=uint64_t(opponent(side))*L.per_side+index_of(L, t);
+                    Undo u;
+                    B.make_move(m, u);
+                    MoveList replies;
+                    legal_moves(B, replies);
+                    for(Move x : replies){
+                        if(x.kind()!=move_en_passant){
+                            d.others=true;
+                            continue;
+                        }
+                        Undo v;
+                        B.make_move(x, v);
+                        tb_result r=tb.probe(B);
+                        B.unmake_move(v);
+                        if(!r.found){
+                            missing=true;
+                            continue;
+                        }
+                        int code=(r.wdl<0 ? win_code(r.plies+1) : r.wdl>0 ? loss_code(r.plies+1) : exit_draw);
+                        if(d.capture==0 || preference(code)>preference(d.capture))
+                            d.capture=code;
+                    }
+                    B.unmake_move(u);
+                    found.push_back(d);
+                    continue;
+                }
+                if(B.at(m.to()).empty() && m.kind()!=move_promotion)
+                    continue;
+                Undo u;
+                B.make_move(m, u);
+                tb_result r=tb.probe(B);
+                B.unmake_move(u);
+                if(!r.found){
+                    missing=true;
+                    continue;
+                }
+                int code=(r.wdl<0 ? win_code(r.plies+1) : r.wdl>0 ? loss_code(r.plies+1) : exit_draw);
+                if(best==0 || preference(code)>preference(best))
+                    best=code;
+            }
+            exit[e]=best;
+            value[e].store(0, memory_order_relaxed);
+        }
+        lock_guard<mutex> lock(steps_lock);
+        steps.insert(steps.end(), found.begin(), found.end());
+    });
+    if(missing){
+        out << L.name << ": a smaller table is missing\n";
+        return false;
+    }
+
+    // Count the moves that stay in the table, as the unmoves that lead
+    // back to each position. Symmetric positions make these differ from
+    // its legal moves, but a position's unmoves and the count always
+    // agree.
+    parallel_for(total, threads, [&](uint64_t first, uint64_t last){
+        for(uint64_t e=first; e<last; e++)
+            if(value[e].load(memory_order_relaxed)!=invalid)
+                for_each_predecessor(L, e, [&](uint64_t q){
+                    if(value[q].load(memory_order_relaxed)!=invalid)
+                        count[q].fetch_add(1, memory_order_relaxed);
+                });
+    });
+
+    // A double step that allows en passant is an exit worth what the
+    // position after it is, which depends on the same position without
+    // the right, in this table. Pawns never go back, so that position
+    // cannot lead to the double step again: the table is solved with
+    // the values the double steps reached in the last pass, until they
+    // no longer change.
+    vector<uint8_t> start_value(total), start_count(total), start_exit=exit;
+    for(uint64_t e=0; e<total; e++){
+        start_value[e]=value[e].load(memory_order_relaxed);
+        start_count[e]=count[e].load(memory_order_relaxed);
+    }
+    vector<uint8_t> reached(steps.size(), 0);
+    int passes=0;
+    for(bool settled=false; !settled; passes++){
+        if(passes>0)
+            for(uint64_t e=0; e<total; e++){
+                value[e].store(start_value[e], memory_order_relaxed);
+                count[e].store(start_count[e], memory_order_relaxed);
+            }
+        exit=start_exit;
+        for(size_t i=0; i<steps.size(); i++){
+            int v=reached[i];
+            int code=(v==0 ? exit_draw : v%2 ? loss_code(plies_of(v)+1) : win_code(plies_of(v)+1));
+            uint8_t& x=exit[steps[i].from];
+            if(x==0 || preference(code)>preference(x))
+                x=code;
+        }
+
+        // Positions whose every move leaves the table are decided already.
+        atomic<int> highest{0};
+        parallel_for(total, threads, [&](uint64_t first, uint64_t last){
+            int top=0;
+            for(uint64_t e=first; e<last; e++){
+                int v=value[e].load(memory_order_relaxed);
+                if(v==invalid)
+                    continue;
+                if(v==0 && count[e].load(memory_order_relaxed)==0 && exit[e]!=0 && exit[e]!=exit_draw)
+                    value[e].store(v=exit[e], memory_order_relaxed);
+                if(v)
+                    top=max(top, plies_of(v));
+                if(exit[e]%2 && exit[e]!=exit_draw)
+                    top=max(top, plies_of(exit[e]));
+            }
+            raise_to(highest, top);
+        });
+
+        // Round n settles the positions that are won or lost in n+1 plies.
+        for(int n=0; n<=highest; n++){
+            if(loss_code(n+1)>=invalid){
+                out << L.name << ": mates too long to store\n";
+                return false;
+            }
+            int code=(n%2 ? win_code(n) : loss_code(n));
+            parallel_for(total, threads, [&](uint64_t first, uint64_t last){
+                int top=0;
+                for(uint64_t e=first; e<last; e++){
+                    int v=value[e].load(memory_order_relaxed);
+                    if(n%2 && v==0 && exit[e]==code)
+                        value[e].store(v=code, memory_order_relaxed);
+                    if(v!=code)
+                        continue;
+                    for_each_predecessor(L, e, [&](uint64_t q){
+                        uint8_t zero=0;
+                        if(n%2==0){
+                            if(value[q].compare_exchange_strong(zero, win_code(n+1)))
+                                top=max(top, n+1);
+                        }
+                        else if(count[q].fetch_sub(1)==1 && value[q].load()==0){
+                            int x=exit[q];
+                            if(x==exit_draw || x%2)
+                                return;
+                            int l=max(n+1, x ? plies_of(x) : 0);
+                            if(value[q].compare_exchange_strong(zero, loss_code(l)))
+                                top=max(top, l);
+                        }
+                    });
+                }
+                raise_to(highest, top);
+            });
+        }
+
+        settled=true;
+        for(size_t i=0; i<steps.size(); i++){
+            int v=after_double_step(steps[i], value[steps[i].to].load(memory_order_relaxed));
+            if(v!=reached[i]){
+                reached[i]=v;
+                settled=false;
+            }
+        }
+    }
+
+    uint64_t positions=0, wins=0;
+    int top=0, longest=0;
+    for(uint64_t e=0; e<total; e++){
+        int v=value[e];
+        if(v==invalid)
+            continue;
+        positions++;
+        top=max(top, v);
+        if(v%2){
+            wins++;
+            longest=max(longest, v);
+        }
+    }
+    int bits=1;
+    while((1 << bits)<=top)
+        bits++;
+    vector<unsigned char> file(16+(total*bits+7)/8+1);
+    memcpy(file.data(), "ctb1", 4);
+    file[4]=bits;
+    for(int i=0; i<8; i++)
+        file[8+i]=total >> 8*i & 255;
+    for(uint64_t e=0; e<total; e++){
+        unsigned v=value[e];
+        if(v==invalid)
+            continue;
+        uint64_t bit=e*bits;
+        unsigned w=v << (bit & 7);
+        file[16+(bit >> 3)]|=w & 255;
+        file[16+(bit >> 3)+1]|=w >> 8;
+    }
+    FILE* f=fopen(path.c_str(), "wb");
+    if(f==nullptr || fwrite(file.data(), 1, file.size(), f)!=file.size()){
+        out << L.name << ": cannot write " << path << "\n";
+        if(f)
+            fclose(f);
+        return false;
+    }
+    fclose(f);
+    double seconds=chrono::duration<double>(chrono::steady_clock::now()-start).count();
+    out << L.name << ": " << positions << " positions, " << wins << " won by the side to play, longest mate in "
+        << (longest+1)/2 << " moves, " << bits << " bits each, "
+        << (steps.empty() ? "" : to_string(passes)+" passes for en passant, ") << seconds << " s" << endl;
+    return true;
+}
+
+int generate_tablebases(const string& dir, int pieces, int threads, ostream& out){
+    error_code ec;
+    filesystem::create_directories(dir, ec);
+    tablebase tb(dir);
+    tb.tables.clear();
+
+    // Every material with the stronger side white, fewer pieces first,
+    // then fewer pawns, so that captures and promotions always lead to
+    // tables made already.
+    vector<vector<PieceType>> sides={{}};
+    for(int a=queen; a>=pawn; a--){
+        sides.push_back({PieceType(a)});
+        for(int b=a; b>=pawn; b--)
+            sides.push_back({PieceType(a), PieceType(b)});
+    }
+    vector<tuple<int, int, string>> materials;
+    for(auto& w : sides)
+        for(auto& b : sides){
+            int n=2+w.size()+b.size();
+            if(n==2 || n>pieces || !stronger(w.data(), w.size(), b.data(), b.size()))
+                continue;
+            PieceType extra[2][2]={{w.size()>0 ? w[0] : pawn, w.size()>1 ? w[1] : pawn}, {b.size()>0 ? b[0] : pawn, b.size()>1 ? b[1] : pawn}};
+            int count[2]={int(w.size()), int(b.size())};
+            string name=layout_of(extra, count).name;
+            int pawns=0;
+            for(char c : name)
+                pawns+=(c=='P');
+            materials.emplace_back(n, pawns, name);
+        }
+    sort(materials.begin(), materials.end());
+    for(auto& [n, pawns, name] : materials){
+        if(!generate_table(tb, layout_of(name), dir+"/"+name+".ctb", threads, out) || !tb.load(name)){
+            out << "stopped at " << name << endl;
+            return 1;
+        }
+    }
+    out << materials.size() << " tables in " << dir << endl;
+    return 0;
+}
@@ -0,0 +1,70 @@
+/* Endgame tablebases: every position with up to four pieces, kings
+included, solved to the mate.
+
+"chess tablebase <dir>" generates them by retrograde analysis, one file
+per material, the fewer pieces and pawns first. A table first looks up
+the moves that leave it, captures and promotions, in the tables made
+before it, and counts the moves that stay in it. Then, one ply at a
+time, a loss marks each position that could have led to it as a win,
+and a win takes one off the count of each such position; a position
+whose count runs out, with no better exit, is lost. Every round is a
+pass over the whole table, split among the threads.
+
+Only one position of each set of symmetric ones is kept: the white king
+is mirrored into the a1-d1-d4 triangle, or onto files a-d when there are
+pawns, and identical pieces are put in square order. The stronger side
+is always white in the tables; a position with colors the other way
+round is flipped before it is looked up. Castling rights are left out,
+so such positions are not probed. En passant rights are too: a position
+with one is worth its best move, which probe() looks up after each.
+While a table is made, a double step that allows en passant counts as
+an exit worth as much, which depends on the same position without the
+right, so the table is solved again until those values settle.
+
+A file holds, for each position, 0 for a draw, an odd number p for a
+win by mate in p plies, or an even number p+2 for a loss to mate in p
+plies, in as few bits as its longest mate needs. Files are mapped, so a
+probe reads a byte or two and nothing is loaded up front.
+*/
+
+#ifndef TABLEBASE_H
+#define TABLEBASE_H
+
+#include <map>
+#include <memory>
+#include "board.h"
+#include "pgn.h"
+
+// What the tables say, for the side to play.
+struct tb_result{
+    bool found=false;
+    int wdl=0;      // 1 win, 0 draw, -1 loss
+    int plies=0;    // until mate, when it is not a draw
+};
+
+class tablebase{
+    struct table{
+        mapped_file file;
+        int bits;
+        uint64_t entries;
+        explicit table(const string& path): file(path, false) {}
+    };
+    string dir;
+    map<string, unique_ptr<table>> tables;
+    bool load(const string& material);
+    tb_result probe_moves(chessboard& B) const;
+    friend int generate_tablebases(const string& dir, int pieces, int threads, ostream& out);
+public:
+    // Maps the tables that are found in dir.
+    explicit tablebase(const string& dir);
+    int size() const {return tables.size();}
+    tb_result probe(chessboard& B) const;
+    // The fastest win, else a draw, else the slowest loss; Move() if the
+    // position is not in the tables.
+    Move best_move(chessboard& B) const;
+};
+
+// Writes every table of up to pieces pieces into dir. Returns 0 when done.
+int generate_tablebases(const string& dir, int pieces, int threads, ostream& out);
+
+#endif
@@ -0,0 +1,130 @@
+/* Solves every endgame table of up to four pieces into a scratch
+directory and checks them: on positions they once had wrong, and on
+random king and pawn against king and pawn positions, each of which must
+be worth exactly what its best move is.
+
+usage: tablebase_test [scratch directory]   (the current one by default)
+
+The tables go to a tablebases directory under the scratch directory.
+Exits with 1 on a wrong value.
+*/
+
+#include <random>
+#include <thread>
+#include "tablebase.h"
+
+struct known_value{
+    const char* fen;
+    int wdl;
+    int plies;
+    const char* why;
+};
+
+const known_value known[]={
+    {"8/8/8/8/1p6/6k1/P7/K7 w - - 0 1", 0, 0, "a2-a4 is answered by bxa3 en passant"},
+    {"8/8/8/8/Pp6/6k1/8/K7 b - a3 0 1", 0, 0, "the en passant right itself"},
+};
+
+static string describe(const tb_result& r){
+    if(!r.found)
+        return "not found";
+    if(r.wdl==0)
+        return "a draw";
+    return string(r.wdl>0 ? "a win" : "a loss")+" in "+to_string(r.plies)+" plies";
+}
+
+// What the best move of B is worth, from the tables after each move.
+static tb_result best_of_moves(const tablebase& tb, chessboard& B){
+    tb_result best;
+    MoveList list;
+    legal_moves(B, list);
+    int score=-100000;
+    for(Move m : list){
+        Undo u;
+        B.make_move(m, u);
+        tb_result r=tb.probe(B);
+        B.unmake_move(u);
+        if(!r.found)
+            return r;
+        // fast wins, then draws, then slow losses
+        int s=(r.wdl<0 ? 1000-r.plies : r.wdl>0 ? r.plies-1000 : 0);
+        if(s>score){
+            score=s;
+            best.found=true;
+            best.wdl=-r.wdl;
+            best.plies=(r.wdl ? r.plies+1 : 0);
+        }
+    }
+    if(list.empty()){
+        best.found=true;
+        if(B.is_square_attacked(B.returnPlayer(B.to_play).king, opponent(B.to_play)))
+            best.wdl=-1;
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]){
+    string dir=string(argc>1 ? argv[1] : ".")+"/tablebases";
+    int threads=max(1u, thread::hardware_concurrency());
+    if(generate_tablebases(dir, 4, threads, cout)!=0)
+        return 1;
+    tablebase tb(dir);
+    int wrong=0;
+    for(const known_value& k : known){
+        chessboard B;
+        B.setup(k.fen);
+        tb_result r=tb.probe(B);
+        if(!r.found || r.wdl!=k.wdl || r.plies!=k.plies){
+            tb_result want{true, k.wdl, k.plies};
+            cout << k.fen << ": " << describe(r) << ", not " << describe(want) << " (" << k.why << ")" << endl;
+            wrong++;
+        }
+    }
+
+    // Random positions, with the pawns where double steps and en passant
+    // captures happen often.
+    mt19937 rng(1);
+    int checked=0;
+    while(checked<20000){
+        char board[64];
+        fill(board, board+64, '.');
+        const char pieces[4]={'K', 'k', 'P', 'p'};
+        int sq[4];
+        for(int i=0; i<4; i++){
+            do
+                sq[i]=(i<2 ? rng()%64 : 8+rng()%48);
+            while(board[sq[i]]!='.');
+            board[sq[i]]=pieces[i];
+        }
+        string fen;
+        for(int rank=7; rank>=0; rank--){
+            int empty=0;
+            for(int file=0; file<8; file++){
+                char c=board[8*rank+file];
+                if(c=='.')
+                    empty++;
+                else{
+                    if(empty)
+                        fen+=char('0'+empty);
+                    empty=0;
+                    fen+=c;
+                }
+            }
+            if(empty)
+                fen+=char('0'+empty);
+            fen+=(rank ? "/" : "");
+        }
+        fen+=(rng()%2 ? " w - - 0 1" : " b - - 0 1");
+        chessboard B;
+        if(!B.setup(fen))
+            continue;
+        checked++;
+        tb_result r=tb.probe(B), best=best_of_moves(tb, B);
+        if(!r.found || !best.found || r.wdl!=best.wdl || r.plies!=best.plies){
+            cout << fen << ": " << describe(r) << ", but its best move is worth " << describe(best) << endl;
+            wrong++;
+        }
+    }
+    cout << size(known)+checked-wrong << " of " << size(known)+checked << " positions right" << endl;
+    return wrong ? 1 : 0;
+}
@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+"""Client for "chess serve": plays many sessions against a running server
+at once and checks that every game gets its answers and ends.
+
+usage: server_client.py <port|socket path> [sessions] [session file]
+
+Each session sends the commands of the session file (one command per
+line or several on a line, as a player would type them; by default a
+short game the computer joins with "go" and that ends in resignation),
+then reads until the server closes the connection. A session passes if
+its game ended, that is the last reply names a winner or a draw. Prints
+the time per session and exits with 1 if any failed.
+"""
+
+import socket
+import sys
+import threading
+import time
+
+default_session = """e4
+e5
+Nf3
+go
+go
+hint
+eval
+undo
+Bc4
+resign
+"""
+
+endings = ("wins!", "Draw!")
+
+
+def connect(address):
+    if address.isdigit():
+        return socket.create_connection(("127.0.0.1", int(address)))
+    s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    s.connect(address)
+    return s
+
+
+def play(address, commands, results, i):
+    start = time.monotonic()
+    try:
+        with connect(address) as s:
+            s.sendall(commands.encode())
+            s.shutdown(socket.SHUT_WR)
+            reply = b""
+            while True:
+                data = s.recv(65536)
+                if not data:
+                    break
+                reply += data
+        text = reply.decode(errors="replace").rstrip()
+        ok = any(text.endswith(e) for e in endings)
+        results[i] = (ok, time.monotonic() - start, text.splitlines()[-1] if text else "")
+    except OSError as e:
+        results[i] = (False, time.monotonic() - start, str(e))
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__.split("\n\n")[1])
+        return 1
+    address = sys.argv[1]
+    sessions = int(sys.argv[2]) if len(sys.argv) > 2 else 8
+    commands = default_session
+    if len(sys.argv) > 3:
+        with open(sys.argv[3]) as f:
+            commands = f.read()
+    results = [None] * sessions
+    threads = [threading.Thread(target=play, args=(address, commands, results, i)) for i in range(sessions)]
+    start = time.monotonic()
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    failed = 0
+    for i, (ok, seconds, last) in enumerate(results):
+        print("session %d: %s in %.3f s (%s)" % (i + 1, "ok" if ok else "FAILED", seconds, last))
+        failed += not ok
+    print("%d sessions, %d failed, %.3f s in all" % (sessions, failed, time.monotonic() - start))
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
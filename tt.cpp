@@ -0,0 +1,143 @@
+#include <cstdlib>
+#include <cstring>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+#include "tt.h"
+
+static uint64_t pack(uint16_t move, int score, int depth, Bound bound, uint8_t age){
+    return uint64_t(move) | uint64_t(uint16_t(score)) << 16 | uint64_t(uint8_t(depth)) << 32
+         | uint64_t(bound) << 40 | uint64_t(age & 63) << 42;
+}
+
+static tt_data unpack(uint64_t data){
+    tt_data d;
+    d.move=uint16_t(data);
+    d.score=int16_t(data >> 16);
+    d.depth=int8_t(data >> 32);
+    d.bound=Bound(data >> 40 & 3);
+    d.age=uint8_t(data >> 42 & 63);
+    return d;
+}
+
+transposition_table:: transposition_table(size_t megabytes){
+    resize(megabytes);
+}
+
+transposition_table:: ~transposition_table(){
+    release();
+}
+
+void transposition_table:: release(){
+#ifdef __linux__
+    if(huge_pages)
+        munmap(buckets, count*sizeof(Bucket));
+    else
+#endif
+    free(buckets);
+    buckets=nullptr;
+    huge_pages=false;
+}
+
+// Rounds down to a power of two number of buckets. On Linux a table of
+// 2 MB or more is mapped with transparent huge pages when the system
+// allows it, which saves most of the TLB misses of random probing.
+void transposition_table:: resize(size_t megabytes){
+    release();
+    size_t bytes=max<size_t>(megabytes, 1) << 20;
+    count=1;
+    while(count*2*sizeof(Bucket)<=bytes)
+        count*=2;
+    bytes=count*sizeof(Bucket);
+#ifdef __linux__
+    if(bytes>=(2u << 20)){
+        void* p=mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(p!=MAP_FAILED){
+            madvise(p, bytes, MADV_HUGEPAGE);
+            buckets=static_cast<Bucket*>(p);
+            huge_pages=true;
+        }
+    }
+#endif
+    if(buckets==nullptr)
+        buckets=static_cast<Bucket*>(aligned_alloc(alignof(Bucket), bytes));
+    if(buckets==nullptr)
+        throw bad_alloc();
+    clear();
+}
+
+void transposition_table:: clear(){
+    memset(static_cast<void*>(buckets), 0, count*sizeof(Bucket));
+    generation.store(0, memory_order_relaxed);
+}
+
+void transposition_table:: new_search(){
+    generation.store((generation.load(memory_order_relaxed)+1) & 63, memory_order_relaxed);
+}
+
+bool transposition_table:: probe(bitboard key, tt_data &d) const{
+    const Bucket& b=buckets[key & (count-1)];
+    for(int i=0; i<4; i++){
+        uint64_t data=b.slot[i].data.load(memory_order_relaxed);
+        uint64_t check=b.slot[i].check.load(memory_order_relaxed);
+        if((check^data)==key && data!=0){
+            d=unpack(data);
+            return true;
+        }
+    }
+    return false;
+}
+
+void transposition_table:: store(bitboard key, uint16_t move, int score, int depth, Bound bound){
+    Bucket& b=buckets[key & (count-1)];
+    uint8_t g=generation.load(memory_order_relaxed);
+    Slot* replace=nullptr;
+    int worst=1 << 30;
+    for(int i=0; i<4; i++){
+        uint64_t data=b.slot[i].data.load(memory_order_relaxed);
+        uint64_t check=b.slot[i].check.load(memory_order_relaxed);
+        if(data==0){
+            if(worst>-(1 << 20)){
+                replace=&b.slot[i];
+                worst=-(1 << 20);
+            }
+            continue;
+        }
+        tt_data d=unpack(data);
+        if((check^data)==key){
+            // Same position: keep a deeper result from this search unless
+            // the new one is exact, but never lose the best move.
+            if(d.depth>depth+2 && d.age==g && bound!=bound_exact)
+                return;
+            if(move==0)
+                move=d.move;
+            replace=&b.slot[i];
+            break;
+        }
+        int value=d.depth-8*((g-d.age) & 63);
+        if(value<worst){
+            worst=value;
+            replace=&b.slot[i];
+        }
+    }
+    uint64_t data=pack(move, score, depth, bound, g);
+    replace->data.store(data, memory_order_relaxed);
+    replace->check.store(key^data, memory_order_relaxed);
+}
+
+int transposition_table:: hashfull() const{
+    int used=0;
+    uint8_t g=generation.load(memory_order_relaxed);
+    size_t n=min<size_t>(count, 1000);
+    for(size_t i=0; i<n; i++)
+        for(int j=0; j<4; j++){
+            uint64_t data=buckets[i].slot[j].data.load(memory_order_relaxed);
+            if(data!=0 && unpack(data).age==g)
+                used++;
+        }
+    return n ? used*1000/(4*n) : 0;
+}
+
+size_t transposition_table:: megabytes() const{
+    return count*sizeof(Bucket) >> 20;
+}
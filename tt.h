@@ -0,0 +1,65 @@
+/* Transposition table: a fixed-size hash of search results keyed by
+chessboard::key, shared by every search thread without a lock.
+
+Each slot is two 64-bit words, the data and key^data. A reader accepts a
+slot only if the two words XOR back to its key. A write torn by another
+thread therefore reads as a miss and never as another position's result.
+Slots come in buckets of four, one cache line. A store replaces the
+same position or else the shallowest and oldest slot in the bucket.
+*/
+
+#ifndef TT_H
+#define TT_H
+
+#include <atomic>
+#include <cstddef>
+#include "board.h"
+
+enum Bound{bound_none, bound_upper, bound_lower, bound_exact};
+
+struct tt_data{
+    uint16_t move;      // Move::data, 0 for none
+    int16_t score;
+    int8_t depth;
+    Bound bound;
+    uint8_t age;
+};
+
+class transposition_table{
+public:
+    transposition_table(size_t megabytes=16);
+    ~transposition_table();
+    transposition_table(const transposition_table&)=delete;
+    transposition_table& operator=(const transposition_table&)=delete;
+
+    // Neither of these is safe while a search is running.
+    void resize(size_t megabytes);
+    void clear();
+
+    // Called once per search, so entries from older searches give way.
+    void new_search();
+    bool probe(bitboard key, tt_data &d) const;
+    void store(bitboard key, uint16_t move, int score, int depth, Bound bound);
+    // Used slots of this search in the first thousand buckets, per mille.
+    int hashfull() const;
+    size_t megabytes() const;
+
+private:
+    void release();
+    struct Slot{
+        atomic<uint64_t> check;   // key^data
+        atomic<uint64_t> data;
+    };
+    struct alignas(64) Bucket{
+        Slot slot[4];
+    };
+    Bucket* buckets=nullptr;
+    size_t count=0;      // a power of two
+    bool huge_pages=false;
+    // Searches of several games can share the table, so this is atomic
+    // and read once per call. Two new_search() at once may bump it only
+    // once, which does no harm.
+    atomic<uint8_t> generation{0};
+};
+
+#endif